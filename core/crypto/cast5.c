@@ -181,6 +181,17 @@ void cast5_init(const void* key, uint16_t keylength_b, cast5_ctx_t* s){
 	cast5_init_A((uint8_t*)(&x[0]), (uint8_t*)(&z[0]), true);
 	/***** M' *****/
 	cast5_init_rM(&(s->rotl[0]), &(s->roth[0]), 3, (uint8_t*)(&x[0]), false, true);
+#ifdef CAST5_UNROLLED
+	/* the unrolled rounds want the masking keys in native byte order
+	 * and one rotation key per round */
+	for (uint8_t i = 0; i < 16; ++i){
+		uint8_t *m = (uint8_t*)&(s->mask[i]);
+		s->mask[i] = (uint32_t)m[0]<<24 | (uint32_t)m[1]<<16
+		             | (uint16_t)m[2]<<8 | m[3];
+		s->rot[i] = (((s->roth[i>>3]) & (1<<(i&0x7)))?0x10:0x00)
+		            + (((s->rotl[i>>1])>>((i&1)?4:0)) & 0x0f);
+	}
+#endif
 	/* done ;-) */
 }
 
@@ -191,6 +202,8 @@ void cast5_init(const void* key, uint16_t keylength_b, cast5_ctx_t* s){
 #define ROTL32(a,n) ((a)<<(n) | (a)>>(32-(n)))
 #define CHANGE_ENDIAN32(x) ((x)<<24 | (x)>>24 | ((x)&0xff00)<<8 | ((x)&0xff0000)>>8 )
 
+#ifndef CAST5_UNROLLED
+
 typedef uint32_t cast5_f_t(uint32_t,uint32_t,uint8_t);
 
 #define IA 3
@@ -335,6 +348,102 @@ void cast5_dec(void* block, const cast5_ctx_t *s){
 	((uint32_t*)block)[1]=l;
 }
 
+#else /* CAST5_UNROLLED */
+
+/* Unrolled variant: the round functions are inlined, the data is kept
+ * in native byte order and the key schedule is used as prepared by
+ * cast5_init, so no per-round key decoding is left. */
+
+#define S1(x) pgm_read_dword(&s1[(x)])
+#define S2(x) pgm_read_dword(&s2[(x)])
+#define S3(x) pgm_read_dword(&s3[(x)])
+#define S4(x) pgm_read_dword(&s4[(x)])
+
+#define ROTLN(a,n) ((a)<<(n) | (a)>>((32-(n))&31))
+
+static inline
+uint32_t cast5_f1(uint32_t d, uint32_t m, uint8_t r){
+	uint32_t t = m + d;
+	t = ROTLN(t, r);
+	return ((S1(t>>24) ^ S2((uint8_t)(t>>16))) - S3((uint8_t)(t>>8)))
+	       + S4((uint8_t)t);
+}
+
+static inline
+uint32_t cast5_f2(uint32_t d, uint32_t m, uint8_t r){
+	uint32_t t = m ^ d;
+	t = ROTLN(t, r);
+	return ((S1(t>>24) - S2((uint8_t)(t>>16))) + S3((uint8_t)(t>>8)))
+	       ^ S4((uint8_t)t);
+}
+
+static inline
+uint32_t cast5_f3(uint32_t d, uint32_t m, uint8_t r){
+	uint32_t t = m - d;
+	t = ROTLN(t, r);
+	return ((S1(t>>24) + S2((uint8_t)(t>>16))) ^ S3((uint8_t)(t>>8)))
+	       - S4((uint8_t)t);
+}
+
+#define ROUND(f,a,b,i) ((a) ^= f((b), s->mask[(i)], s->rot[(i)]))
+
+/******************************************************************************/
+
+void cast5_enc(void* block, const cast5_ctx_t *s){
+	uint32_t l, r;
+	l = CHANGE_ENDIAN32(((uint32_t*)block)[0]);
+	r = CHANGE_ENDIAN32(((uint32_t*)block)[1]);
+	ROUND(cast5_f1, l, r,  0);
+	ROUND(cast5_f2, r, l,  1);
+	ROUND(cast5_f3, l, r,  2);
+	ROUND(cast5_f1, r, l,  3);
+	ROUND(cast5_f2, l, r,  4);
+	ROUND(cast5_f3, r, l,  5);
+	ROUND(cast5_f1, l, r,  6);
+	ROUND(cast5_f2, r, l,  7);
+	ROUND(cast5_f3, l, r,  8);
+	ROUND(cast5_f1, r, l,  9);
+	ROUND(cast5_f2, l, r, 10);
+	ROUND(cast5_f3, r, l, 11);
+	if (!s->shortkey){
+		ROUND(cast5_f1, l, r, 12);
+		ROUND(cast5_f2, r, l, 13);
+		ROUND(cast5_f3, l, r, 14);
+		ROUND(cast5_f1, r, l, 15);
+	}
+	((uint32_t*)block)[0]=CHANGE_ENDIAN32(r);
+	((uint32_t*)block)[1]=CHANGE_ENDIAN32(l);
+}
+
+/******************************************************************************/
+
+void cast5_dec(void* block, const cast5_ctx_t *s){
+	uint32_t l, r;
+	l = CHANGE_ENDIAN32(((uint32_t*)block)[0]);
+	r = CHANGE_ENDIAN32(((uint32_t*)block)[1]);
+	if (!s->shortkey){
+		ROUND(cast5_f1, l, r, 15);
+		ROUND(cast5_f3, r, l, 14);
+		ROUND(cast5_f2, l, r, 13);
+		ROUND(cast5_f1, r, l, 12);
+	}
+	ROUND(cast5_f3, l, r, 11);
+	ROUND(cast5_f2, r, l, 10);
+	ROUND(cast5_f1, l, r,  9);
+	ROUND(cast5_f3, r, l,  8);
+	ROUND(cast5_f2, l, r,  7);
+	ROUND(cast5_f1, r, l,  6);
+	ROUND(cast5_f3, l, r,  5);
+	ROUND(cast5_f2, r, l,  4);
+	ROUND(cast5_f1, l, r,  3);
+	ROUND(cast5_f3, r, l,  2);
+	ROUND(cast5_f2, l, r,  1);
+	ROUND(cast5_f1, r, l,  0);
+	((uint32_t*)block)[0]=CHANGE_ENDIAN32(r);
+	((uint32_t*)block)[1]=CHANGE_ENDIAN32(l);
+}
+
+#endif /* CAST5_UNROLLED */
 
 /******************************************************************************/
 
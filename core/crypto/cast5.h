@@ -29,6 +29,7 @@
 #define CAST5_H_ 
 
 #include <stdint.h> 
+#include "config.h"
 
 #ifndef BOOL
 #define BOOL
@@ -52,6 +53,9 @@ typedef struct cast5_ctx_st{
 	uint32_t	mask[16];
 	uint8_t		rotl[8];	/* 4 bit from every rotation key is stored here */
 	uint8_t		roth[2];	/* 1 bit from every rotation key is stored here */
+#ifdef CAST5_UNROLLED
+	uint8_t		rot[16];	/* expanded rotation keys, one per round */
+#endif
 	bool		shortkey;
 } cast5_ctx_t;
 
@@ -46,6 +46,7 @@ uint8_t vfs_host_fseek (struct vfs_file_handle_t *, vfs_size_t offset,
     NULL, /* truncate */		\
     NULL, /* create */			\
     NULL, /* size */			\
+    NULL, /* etag */			\
   }
 
 #endif  /* CORE_HOST_VFS_H */
@@ -35,7 +35,10 @@ usage (int exitval)
 {
   fprintf (exitval ? stderr : stdout,
 	   "Usage: vfs-concat IMAGE BLOCKSZ FILE\n"
-	   "Concatenate FILE to existing ethersex IMAGE.\n\n");
+	   "Concatenate FILE to existing ethersex IMAGE.\n\n"
+	   "       vfs-concat -d IMAGE BLOCKSZ START\n"
+	   "Append the file directory to IMAGE, whose inlined files\n"
+	   "start after the first START bytes.\n\n");
   exit (exitval);
 }
 
@@ -69,16 +72,90 @@ crc_calc (uint8_t *data, int len)
 }
 
 
+static int
+compare_dirent (const void *a, const void *b)
+{
+  const struct vfs_inline_dirent_t *ea = a, *eb = b;
+  return (int) ea->hash - (int) eb->hash;
+}
+
+
+static int
+write_directory (char *image, int pagesz, int start)
+{
+  uint8_t buf_image[BUFLEN];
+  struct vfs_inline_dirent_t dir_ent[256];
+  struct vfs_inline_dir_t dir = { .count = 0, .crc = 0 };
+  union vfs_inline_node_t node;
+  int image_len, offset;
+  FILE *f;
+
+  if ((f = fopen (image, "rb")) == NULL) {
+    fprintf (stderr, "vfs-concat: Unable to read %s.\n", image);
+    return 1;
+  }
+
+  image_len = fread (buf_image, 1, BUFLEN, f);
+  fclose (f);
+
+  /* Walk along the inlined files, they are page aligned. */
+  offset = (start + pagesz - 1) / pagesz * pagesz;
+  while (offset + (int) sizeof (node) < image_len) {
+    if (buf_image[offset] != VFS_INLINE_MAGIC) {
+      fprintf (stderr, "vfs-concat: No file node at %d.\n", offset);
+      return 1;
+    }
+
+    if (dir.count == 255) {
+      fprintf (stderr, "vfs-concat: Too many files.\n");
+      return 1;
+    }
+
+    memcpy (node.raw, buf_image + offset + 1, sizeof (node));
+    dir_ent[dir.count].hash = vfs_inline_hash (node.s.fn);
+    dir_ent[dir.count].page = offset / pagesz;
+    dir.count ++;
+
+    offset += 1 + sizeof (node) + node.s.len;
+    offset = (offset + pagesz - 1) / pagesz * pagesz;
+  }
+
+  qsort (dir_ent, dir.count, sizeof (*dir_ent), compare_dirent);
+  dir.crc = crc_calc ((uint8_t *) dir_ent, dir.count * sizeof (*dir_ent));
+
+  fprintf (stderr, "vfs-concat: Directory with %d files at %d.\n",
+	   dir.count, offset);
+
+  fwrite (buf_image, 1, image_len, stdout);
+
+  while (image_len % pagesz) {
+    putchar (0xFF);
+    image_len ++;
+  }
+
+  putchar (VFS_INLINE_DIR_MAGIC);
+  fwrite (&dir, sizeof (dir), 1, stdout);
+  fwrite (dir_ent, sizeof (*dir_ent), dir.count, stdout);
+
+  return 0;
+}
+
+
 int
 main (int argc, char **argv)
 {
   uint8_t buf_image[BUFLEN], buf_file[BUFLEN];
-  int image_len, file_len, pagesz;
+  int image_len, file_len, pagesz, directory = 0;
   FILE *f;
   union vfs_inline_node_t node = { .s = { .fn = "", .len = 0 } };
   char *ptr;
 
   if (argc == 2 && strcmp (argv[1], "--help") == 0) usage (0);
+  if (argc == 5 && strcmp (argv[1], "-d") == 0) {
+    directory = 1;
+    argc --;
+    argv ++;
+  }
   if (argc != 4) usage (1);
 
   pagesz = atoi (argv[2]);
@@ -87,6 +164,9 @@ main (int argc, char **argv)
     return 1;
   }
 
+  if (directory)
+    return write_directory (argv[1], pagesz, atoi (argv[3]));
+
   if ((f = fopen (argv[1], "rb")) == NULL) {
     fprintf (stderr, "vfs-concat: Unable to read %s.\n", argv[1]);
     return 1;
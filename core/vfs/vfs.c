@@ -20,6 +20,7 @@
  */
 
 #include <avr/pgmspace.h>
+#include <string.h>
 #include "core/debug.h"
 #include "core/vfs/vfs.h"
 #ifndef VFS_TEENSY
@@ -54,17 +55,118 @@ const struct vfs_func_t vfs_funcs[] PROGMEM = {
 #endif
 };
 
+#ifdef VFS_NEGCACHE_SUPPORT
+/* Names that recently failed to open, so repeated lookups of missing
+   files don't have to ask every (possibly slow) backend again.  Longer
+   names are not cached. */
+#define VFS_NEGCACHE_NAMELEN 16
+
+static struct {
+  char name[VFS_NEGCACHE_NAMELEN];
+  uint16_t ttl;
+} vfs_negcache[VFS_NEGCACHE_ENTRIES];
+
+/* Set by VFS modules if open failed for a temporary reason. */
+uint8_t vfs_negcache_skip;
+
+static uint8_t
+vfs_negcache_lookup (const char *filename)
+{
+  for (uint8_t i = 0; i < VFS_NEGCACHE_ENTRIES; i ++)
+    if (vfs_negcache[i].ttl
+	&& strncmp (vfs_negcache[i].name, filename, VFS_NEGCACHE_NAMELEN) == 0)
+      return 1;
+  return 0;
+}
+
+static void
+vfs_negcache_insert (const char *filename)
+{
+  if (strlen (filename) >= VFS_NEGCACHE_NAMELEN)
+    return;
+
+  /* Replace the entry that expires first. */
+  uint8_t j = 0;
+  for (uint8_t i = 1; i < VFS_NEGCACHE_ENTRIES; i ++)
+    if (vfs_negcache[i].ttl < vfs_negcache[j].ttl)
+      j = i;
+
+  strcpy (vfs_negcache[j].name, filename);
+  vfs_negcache[j].ttl = VFS_NEGCACHE_TTL;
+}
+
+void
+vfs_negcache_flush (void)
+{
+  for (uint8_t i = 0; i < VFS_NEGCACHE_ENTRIES; i ++)
+    vfs_negcache[i].ttl = 0;
+}
+
+void
+vfs_negcache_periodic (void)
+{
+  for (uint8_t i = 0; i < VFS_NEGCACHE_ENTRIES; i ++)
+    if (vfs_negcache[i].ttl)
+      vfs_negcache[i].ttl --;
+}
+#endif	/* VFS_NEGCACHE_SUPPORT */
+
+#ifdef VFS_MOUNT_SUPPORT
+/* Check whether FILENAME starts with the name of a VFS module followed by
+   a slash (e.g. "sd/log.txt").  If so, strip the prefix and return the
+   module's vfs_type_t, VFS_LAST otherwise. */
+static uint8_t
+vfs_mount (const char **filename)
+{
+  const char *name = *filename;
+  if (*name == '/')
+    name ++;
+
+  for (uint8_t i = 0; i < VFS_LAST; i ++) {
+    const char *mod_name = (const char *) pgm_read_word (&vfs_funcs[i].mod_name);
+    uint8_t len = strlen (mod_name);
+
+    if (strncmp (name, mod_name, len) == 0 && name[len] == '/') {
+      *filename = name + len + 1;
+      return i;
+    }
+  }
+
+  return VFS_LAST;
+}
+#endif	/* VFS_MOUNT_SUPPORT */
+
 struct vfs_file_handle_t *
 vfs_open (const char *filename)
 {
   struct vfs_file_handle_t *fh = NULL;
   struct vfs_func_t funcs;
+  uint8_t i = 0, last = VFS_LAST;
+
+#ifdef VFS_NEGCACHE_SUPPORT
+  const char *name = filename;
+  if (vfs_negcache_lookup (name))
+    return NULL;
+  vfs_negcache_skip = 0;
+#endif
 
-  for (uint8_t i = 0; fh == NULL && i < VFS_LAST; i ++) {
+#ifdef VFS_MOUNT_SUPPORT
+  if ((i = vfs_mount (&filename)) == VFS_LAST)
+    i = 0;
+  else
+    last = i + 1;
+#endif
+
+  for (; fh == NULL && i < last; i ++) {
     memcpy_P(&funcs, &vfs_funcs[i], sizeof(struct vfs_func_t));
     fh = funcs.open (filename);
   }
 
+#ifdef VFS_NEGCACHE_SUPPORT
+  if (fh == NULL && !vfs_negcache_skip)
+    vfs_negcache_insert (name);
+#endif
+
   return fh;
 }
 
@@ -73,8 +175,20 @@ vfs_create (const char *name)
 {
   struct vfs_file_handle_t *fh = NULL;
   struct vfs_func_t funcs;
+  uint8_t i = 0, last = VFS_LAST;
 
-  for (uint8_t i = 0; fh == NULL && i < VFS_LAST; i ++) {
+#ifdef VFS_NEGCACHE_SUPPORT
+  vfs_negcache_flush ();
+#endif
+
+#ifdef VFS_MOUNT_SUPPORT
+  if ((i = vfs_mount (&name)) == VFS_LAST)
+    i = 0;
+  else
+    last = i + 1;
+#endif
+
+  for (; fh == NULL && i < last; i ++) {
     memcpy_P(&funcs, &vfs_funcs[i], sizeof(struct vfs_func_t));
     if (funcs.create)
       fh = funcs.create (name);
@@ -102,6 +216,17 @@ vfs_read_write_size(uint8_t flag, struct vfs_file_handle_t *handle, void *buf,
     return 0;
 }
 
+uint32_t
+vfs_etag (struct vfs_file_handle_t *handle)
+{
+  struct vfs_func_t funcs;
+  memcpy_P(&funcs, &vfs_funcs[handle->fh_type], sizeof(struct vfs_func_t));
+
+  if (funcs.etag)
+    return funcs.etag(handle);
+  return 0;
+}
+
 /* flag: 0=fseek, 1=truncate, 2=close */
 uint8_t
 vfs_fseek_truncate_close(uint8_t flag, struct vfs_file_handle_t *handle,
@@ -129,4 +254,5 @@ vfs_fseek_truncate_close(uint8_t flag, struct vfs_file_handle_t *handle,
 /*
   -- Ethersex META --
   header(core/vfs/vfs.h)
+  ifdef(`conf_VFS_NEGCACHE', `timer(50, vfs_negcache_periodic())')
 */
@@ -129,6 +129,10 @@ struct vfs_func_t {
 
   /* Return the size of the file. */
   vfs_size_t (*size) (struct vfs_file_handle_t *);
+
+  /* Return a value that changes whenever the content of the file
+     changes (used as HTTP entity tag), 0 if unknown. */
+  uint32_t (*etag) (struct vfs_file_handle_t *);
 };
 
 extern const struct vfs_func_t vfs_funcs[];
@@ -138,13 +142,29 @@ extern const struct vfs_func_t vfs_funcs[];
 #define SEEK_END 2
 
 /* Generic variant of open that automagically finds the suitable
-   VFS module. */
+   VFS module.  With VFS_MOUNT_SUPPORT a FILENAME starting with a module
+   name, e.g. "sd/log.txt", is passed to that module only. */
 struct vfs_file_handle_t *vfs_open (const char *filename);
 
 /* Generic variante of create, that automatically finds a suitable
    store for the new file. */
 struct vfs_file_handle_t *vfs_create (const char *name);
 
+#ifdef VFS_NEGCACHE_SUPPORT
+/* Forget about all files that recently failed to open, call this if
+   files are created without using vfs_create. */
+void vfs_negcache_flush (void);
+void vfs_negcache_periodic (void);
+
+/* VFS modules call vfs_open_error() if open fails for another reason
+   than the file not existing (e.g. out of memory), so the failure is
+   not cached. */
+extern uint8_t vfs_negcache_skip;
+#define vfs_open_error() (vfs_negcache_skip = 1)
+#else
+#define vfs_open_error() do { } while (0)
+#endif
+
 uint8_t vfs_fseek_truncate_close(uint8_t flag, struct vfs_file_handle_t *handle,
                          vfs_size_t length, uint8_t whence);
 
@@ -172,6 +192,8 @@ vfs_size_t vfs_read_write_size(uint8_t flag, struct vfs_file_handle_t *handle,
 
 #define vfs_rewind(handle)      vfs_fseek(handle, 0, SEEK_SET)
 
+uint32_t vfs_etag (struct vfs_file_handle_t *handle);
+
 /* Synonym to be more like posix :) */
 #define vfs_creat(n...)		vfs_create(n)
 
@@ -20,6 +20,7 @@
  */
 
 #include <avr/pgmspace.h>
+#include <util/crc16.h>
 
 #include <stdlib.h>
 
@@ -32,37 +33,145 @@
 #define __pgm_read_byte pgm_read_byte_near
 #endif
 
+/* Offset of the file directory in program memory, 0 if there is none. */
+#define VFS_INLINE_DIR_UNKNOWN 1
+static vfs_size_t vfs_inline_dir = VFS_INLINE_DIR_UNKNOWN;
 
-struct vfs_file_handle_t *
-vfs_inline_open (const char *filename)
+
+/* Check whether the node at OFFSET is valid, read it to NODE. */
+static uint8_t
+vfs_inline_read_node (vfs_size_t offset, union vfs_inline_node_t *node)
+{
+  if (__pgm_read_byte (offset) != VFS_INLINE_MAGIC)
+    return 0;
+
+  for (uint8_t i = 0; i < sizeof (*node); i ++)
+    node->raw[i] = __pgm_read_byte (offset + i + 1);
+
+  return node->s.crc == crc_checksum (node->raw, sizeof (*node) - 1);
+}
+
+
+/* Create a file handle if the node at OFFSET is named FILENAME. */
+static struct vfs_file_handle_t *
+vfs_inline_try_open (vfs_size_t offset, const char *filename)
+{
+  union vfs_inline_node_t node;
+
+  if (!vfs_inline_read_node (offset, &node))
+    return NULL;
+
+  if (strncmp (node.s.fn, filename, VFS_INLINE_FNLEN))
+    return NULL;
+
+  /* Found file, create a handle. */
+  struct vfs_file_handle_t *fh = malloc (sizeof (struct vfs_file_handle_t));
+  if (fh == NULL) {
+    vfs_open_error ();
+    return NULL;
+  }
+
+  fh->fh_type = VFS_INLINE;
+  fh->u.il.offset = offset + sizeof (union vfs_inline_node_t) + 1;
+  fh->u.il.pos = 0;
+  fh->u.il.len = node.s.len;
+  return fh;
+}
+
+
+/* Find the file directory.  It is written after the last file, therefore
+   scanning backwards either hits the directory or a file node first. */
+static vfs_size_t
+vfs_inline_find_dir (void)
 {
   vfs_size_t offset = FLASHEND - SPM_PAGESIZE + 1;
   for (; offset; offset -= SPM_PAGESIZE) {
-    if (__pgm_read_byte (offset) != VFS_INLINE_MAGIC)
+    union vfs_inline_node_t node;
+    if (vfs_inline_read_node (offset, &node))
+      return 0;			/* Found a file, no directory. */
+
+    if (__pgm_read_byte (offset) != VFS_INLINE_DIR_MAGIC)
       continue;
 
-    union vfs_inline_node_t node;
-    uint8_t i;
+    struct vfs_inline_dir_t dir;
+    for (uint8_t i = 0; i < sizeof (dir); i ++)
+      ((uint8_t *) &dir)[i] = __pgm_read_byte (offset + i + 1);
 
-    for (i = 0; i < sizeof (node); i ++)
-      node.raw[i] = __pgm_read_byte (offset + i + 1);
+    vfs_size_t ptr = offset + sizeof (dir) + 1;
+    vfs_size_t end = ptr + dir.count * sizeof (struct vfs_inline_dirent_t);
+    uint8_t crc = 0;
+    for (; ptr < end; ptr ++)
+      crc = _crc_ibutton_update (crc, __pgm_read_byte (ptr));
 
-    if (node.s.crc != crc_checksum (node.raw, sizeof (node) - 1))
-      continue;
+    if (crc == dir.crc)
+      return offset;
+  }
 
-    if (strncmp (node.s.fn, filename, VFS_INLINE_FNLEN))
-      continue;
+  return 0;
+}
 
-    /* Found file, create a handle. */
-    struct vfs_file_handle_t *fh = malloc (sizeof (struct vfs_file_handle_t));
-    if (fh == NULL)
-      return NULL;
 
-    fh->fh_type = VFS_INLINE;
-    fh->u.il.offset = offset + sizeof (union vfs_inline_node_t) + 1;
-    fh->u.il.pos = 0;
-    fh->u.il.len = node.s.len;
-    return fh;
+static void
+vfs_inline_read_dirent (vfs_size_t offset, uint8_t n,
+			struct vfs_inline_dirent_t *ent)
+{
+  offset += 1 + sizeof (struct vfs_inline_dir_t)
+    + n * sizeof (struct vfs_inline_dirent_t);
+  for (uint8_t i = 0; i < sizeof (*ent); i ++)
+    ((uint8_t *) ent)[i] = __pgm_read_byte (offset + i);
+}
+
+
+/* Binary search the file directory for FILENAME. */
+static struct vfs_file_handle_t *
+vfs_inline_dir_open (const char *filename)
+{
+  struct vfs_inline_dirent_t ent;
+  uint16_t hash = vfs_inline_hash (filename);
+  uint8_t count = __pgm_read_byte (vfs_inline_dir + 1); /* dir.count */
+  uint8_t lo = 0;
+  uint8_t hi = count;
+
+  while (lo < hi) {
+    uint8_t mid = (lo + hi) / 2;
+    vfs_inline_read_dirent (vfs_inline_dir, mid, &ent);
+    if (ent.hash < hash)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  /* LO is the first entry with a matching hash, if any. */
+  for (; lo < count; lo ++) {
+    vfs_inline_read_dirent (vfs_inline_dir, lo, &ent);
+    if (ent.hash != hash)
+      break;
+
+    struct vfs_file_handle_t *fh =
+      vfs_inline_try_open ((vfs_size_t) ent.page * SPM_PAGESIZE, filename);
+    if (fh)
+      return fh;
+  }
+
+  return NULL;			/* File not found. */
+}
+
+
+struct vfs_file_handle_t *
+vfs_inline_open (const char *filename)
+{
+  if (vfs_inline_dir == VFS_INLINE_DIR_UNKNOWN)
+    vfs_inline_dir = vfs_inline_find_dir ();
+
+  if (vfs_inline_dir)
+    return vfs_inline_dir_open (filename);
+
+  /* No directory, scan all pages. */
+  vfs_size_t offset = FLASHEND - SPM_PAGESIZE + 1;
+  for (; offset; offset -= SPM_PAGESIZE) {
+    struct vfs_file_handle_t *fh = vfs_inline_try_open (offset, filename);
+    if (fh)
+      return fh;
   }
 
   return NULL;			/* File not found. */
@@ -128,3 +237,19 @@ vfs_inline_size (struct vfs_file_handle_t *fh)
   return fh->u.il.len;
 }
 #endif	/* VFS_TEENSY */
+
+/* Inlined files are gzip'd, the trailer holds the CRC32 of the
+   uncompressed content. */
+uint32_t
+vfs_inline_etag (struct vfs_file_handle_t *fh)
+{
+  if (fh->u.il.len < 18 || __pgm_read_byte (fh->u.il.offset) != 0x1f)
+    return fh->u.il.offset ^ ((uint32_t) fh->u.il.len << 16);
+
+  vfs_size_t ptr = fh->u.il.offset + fh->u.il.len - 8;
+  uint32_t crc = 0;
+  for (uint8_t i = 4; i; i --)
+    crc = (crc << 8) | __pgm_read_byte (ptr + i - 1);
+
+  return crc;
+}
@@ -37,6 +37,30 @@ union vfs_inline_node_t {
   unsigned char raw[0];
 };
 
+/* The file directory is appended after the last inlined file, it starts
+   on a page boundary with VFS_INLINE_DIR_MAGIC followed by the header and
+   COUNT entries sorted by name hash.  CRC covers the entries. */
+#define VFS_INLINE_DIR_MAGIC 0x24
+
+struct vfs_inline_dir_t {
+  uint8_t count;
+  uint8_t crc;
+} __attribute__((__packed__));
+
+struct vfs_inline_dirent_t {
+  uint16_t hash;		/* vfs_inline_hash of the file name */
+  uint16_t page;		/* Page number of the file's node. */
+} __attribute__((__packed__));
+
+static inline uint16_t
+vfs_inline_hash (const char *fn)
+{
+  uint16_t hash = 5381;
+  for (uint8_t i = 0; i < VFS_INLINE_FNLEN && fn[i]; i ++)
+    hash = (hash << 5) + hash + (uint8_t) fn[i];
+  return hash;
+}
+
 typedef struct {
   vfs_size_t offset;		/* Offset in program memory. */
   uint16_t pos;			/* Position in file. */
@@ -51,6 +75,7 @@ vfs_size_t vfs_inline_read  (struct vfs_file_handle_t *, void *buf,
 vfs_size_t vfs_inline_size (struct vfs_file_handle_t *);
 uint8_t vfs_inline_fseek (struct vfs_file_handle_t *, vfs_size_t offset,
 			  uint8_t whence);
+uint32_t vfs_inline_etag (struct vfs_file_handle_t *);
 
 
 #define VFS_INLINE_FUNCS {		\
@@ -63,6 +88,7 @@ uint8_t vfs_inline_fseek (struct vfs_file_handle_t *, vfs_size_t offset,
     NULL, /* truncate */		\
     NULL, /* create */			\
     vfs_inline_size,			\
+    vfs_inline_etag,			\
   }
 
 #endif	/* VFS_INLINE_H */
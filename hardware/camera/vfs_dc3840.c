@@ -38,8 +38,10 @@ vfs_dc3840_open (const char *filename)
 
   /* The camera has taken a picture, create a handle. */
   struct vfs_file_handle_t *fh = malloc (sizeof (struct vfs_file_handle_t));
-  if (fh == NULL)
+  if (fh == NULL) {
+    vfs_open_error ();
     return NULL;
+  }
 
   fh->fh_type = VFS_DC3840;
   fh->u.dc3840.pos = 0;
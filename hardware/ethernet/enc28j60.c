@@ -57,6 +57,8 @@ int16_t enc28j60_next_packet_pointer;
    we have to disable interrupts if support is enabled */
 #  define cs_low()  uint8_t sreg = SREG; cli(); PIN_CLEAR(SPI_CS_NET); 
 #  define cs_high() PIN_SET(SPI_CS_NET); SREG = sreg;
+/* ... so split block transfers, not to block them for a whole frame */
+#  define BURST_LENGTH 64
 #else
 #  define cs_low()  PIN_CLEAR(SPI_CS_NET)
 #  define cs_high() PIN_SET(SPI_CS_NET)
@@ -112,6 +114,37 @@ uint8_t read_buffer_memory(void)
 
 }
 
+void read_buffer_memory_block(void *buf, uint16_t len)
+{
+
+    uint8_t *p = buf;
+
+    while (len > 0) {
+
+        uint16_t n = len;
+#ifdef BURST_LENGTH
+        if (n > BURST_LENGTH)
+            n = BURST_LENGTH;
+#endif
+        len -= n;
+
+        /* aquire device */
+        cs_low();
+
+        /* send opcode once, the read pointer is auto-incremented */
+        spi_send(CMD_RBM);
+
+        /* read data */
+        while (n--)
+            *p++ = spi_send(0);
+
+        /* release device */
+        cs_high();
+
+    }
+
+}
+
 void write_control_register(uint8_t address, uint8_t data)
 {
 
@@ -151,6 +184,37 @@ void write_buffer_memory(uint8_t data)
 
 }
 
+void write_buffer_memory_block(const void *buf, uint16_t len)
+{
+
+    const uint8_t *p = buf;
+
+    while (len > 0) {
+
+        uint16_t n = len;
+#ifdef BURST_LENGTH
+        if (n > BURST_LENGTH)
+            n = BURST_LENGTH;
+#endif
+        len -= n;
+
+        /* aquire device */
+        cs_low();
+
+        /* send opcode once, the write pointer is auto-incremented */
+        spi_send(CMD_WBM);
+
+        /* send data */
+        while (n--)
+            spi_send(*p++);
+
+        /* release device */
+        cs_high();
+
+    }
+
+}
+
 void bit_field_modify(uint8_t address, uint8_t mask, uint8_t opcode)
 {
 
@@ -268,6 +332,50 @@ void reset_rx(void)
 
 }
 
+#ifdef ENC28J60_DMA_CHKSUM_SUPPORT
+/* address of the frame currently processed in the receive buffer, or 0xffff
+ * if uip_buf does not hold a received frame (anymore) */
+uint16_t enc28j60_rx_frame = 0xffff;
+
+uint8_t enc28j60_rx_chksum(uint16_t *sum, uint16_t offset, uint16_t len)
+{
+
+    /* only the frame received last is available (and unchanged) */
+    if (enc28j60_rx_frame == 0xffff
+#ifdef UIP_MULTI_STACK
+            || uip_stack_get_active() != STACK_ENC
+#endif
+            || len == 0)
+        return 0;
+
+    /* the dma wraps at the end of the receive buffer by itself */
+    uint16_t start = RECEIVE_BUFFER_WRAP(enc28j60_rx_frame + offset);
+    uint16_t end = RECEIVE_BUFFER_WRAP(start + len - 1);
+
+    write_control_register(REG_EDMASTL, LO8(start));
+    write_control_register(REG_EDMASTH, HI8(start));
+    write_control_register(REG_EDMANDL, LO8(end));
+    write_control_register(REG_EDMANDH, HI8(end));
+
+    /* start checksum calculation and wait for it */
+    bit_field_set(REG_ECON1, _BV(ECON1_CSUMEN) | _BV(ECON1_DMAST));
+    while (read_control_register(REG_ECON1) & _BV(ECON1_DMAST));
+    bit_field_clear(REG_ECON1, _BV(ECON1_CSUMEN));
+
+    /* the controller returns the complement of the sum in network byte
+     * order, add it to the sum (in host byte order) like chksum() does */
+    uint16_t t = ~((read_control_register(REG_EDMACSH) << 8)
+                   | read_control_register(REG_EDMACSL));
+
+    *sum += t;
+    if (*sum < t)
+        (*sum)++;               /* carry */
+
+    return 1;
+
+}
+#endif
+
 void init_enc28j60(void)
 {
 #ifdef DEBUG_REV6_WORKAROUND
@@ -295,6 +403,10 @@ void init_enc28j60(void)
     /* init next packet pointer */
     enc28j60_next_packet_pointer = RXBUFFER_START;
 
+    /* frames waiting for transmission are lost */
+    enc28j60_tx_queued = 0;
+    enc28j60_tx_started = 0;
+
     /* bring MAC out of reset */
     bit_field_clear(REG_MACON2, _BV(MARST));
 
@@ -386,6 +498,11 @@ void switch_bank(uint8_t bank)
 
 void enc28j60_periodic(void) 
 {
+#ifdef ENC28J60_INT_SUPPORT
+    /* check for frames not signalled by PKTIF, see errata #6 */
+    enc28j60_rx_check = 1;
+#endif
+
     uint8_t mask = _BV(PADCFG0) | _BV(TXCRCEN) | _BV(FRMLNEN);
 #ifdef DEBUG_REV6_WORKAROUND
   if (!DEBUG_GUARD) {
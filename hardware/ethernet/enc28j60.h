@@ -284,6 +284,17 @@
 #define RXBUFFER_START 0x0000   /* start receive buffer at the beginning */
 #define RXBUFFER_END   0x0FFF   /* end receive buffer at 4kb */
 #define TXBUFFER_START 0x1000   /* start transmit buffer at 4kb */
+#define TXBUFFER_END   0x1FFF
+
+/* the transmit buffer is split into slots, so that a frame can be written
+ * while the previous one is transmitted, each slot holds the control
+ * byte, the frame and the status vector written by the controller */
+#define TXBUFFER_SLOT_SIZE (1 + NET_MAX_FRAME_LENGTH + 7)
+#if (TXBUFFER_END - TXBUFFER_START + 1) / TXBUFFER_SLOT_SIZE > 4
+#  define TXBUFFER_SLOTS 4
+#else
+#  define TXBUFFER_SLOTS ((TXBUFFER_END - TXBUFFER_START + 1) / TXBUFFER_SLOT_SIZE)
+#endif
 
 #define RECEIVE_BUFFER_WRAP(x) ((x) & (RXBUFFER_END))
 
@@ -303,14 +314,37 @@ struct transmit_packet_vector_t {
     uint8_t byte[7];
 };
 
+/* receive and transmit statistics */
+struct enc28j60_stats_t {
+    uint16_t rx;                /* frames passed to the stack */
+    uint16_t rx_error;          /* bad frame length, controller reset */
+    uint16_t rx_overflow;       /* receive buffer full (RXERIF) */
+    uint16_t tx;                /* frames queued for transmission */
+    uint16_t tx_drop;           /* all transmit slots busy for too long */
+};
+
+extern struct enc28j60_stats_t enc28j60_stats;
+
+/* frames in the transmit slots, see enc28j60_transmit.c */
+extern uint8_t enc28j60_tx_queued;
+extern uint8_t enc28j60_tx_started;
+#ifdef ENC28J60_DMA_CHKSUM_SUPPORT
+extern uint16_t enc28j60_rx_frame;
+#endif
+#ifdef ENC28J60_INT_SUPPORT
+extern uint8_t enc28j60_rx_check;
+#endif
+
 #define bit_field_clear(addr,mask) bit_field_modify(addr, mask, CMD_BFC);
 #define bit_field_set(addr,mask)   bit_field_modify(addr, mask, CMD_BFS);
 
 /* prototypes */
 uint8_t noinline read_control_register(uint8_t address);
 uint8_t noinline read_buffer_memory(void);
+void noinline read_buffer_memory_block(void *buf, uint16_t len);
 void noinline write_control_register(uint8_t address, uint8_t data);
 void noinline write_buffer_memory(uint8_t data);
+void noinline write_buffer_memory_block(const void *buf, uint16_t len);
 void noinline bit_field_modify(uint8_t address, uint8_t mask, uint8_t opcode);
 void noinline set_read_buffer_pointer(uint16_t address);
 uint16_t noinline get_read_buffer_pointer(void);
@@ -321,6 +355,7 @@ void noinline write_phy(uint8_t address, uint16_t data);
 void noinline reset_controller(void);
 void noinline reset_rx(void);
 void init_enc28j60(void);
+void enc28j60_tx_kick(void);
 void enc28j60_periodic(void);
 void noinline switch_bank(uint8_t bank);
 void network_config_load(void);
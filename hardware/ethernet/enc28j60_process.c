@@ -31,36 +31,55 @@
 
 #include "core/debug.h"
 
-/*FIXME: interrupts not supported */
-#define ENC28J60_POLL
-#ifndef ENC28J60_POLL
-    #define interrupt_occured() (! PIN_HIGH(INT_PIN))
-    #define wol_interrupt_occured() (! PIN_HIGH(WOL_PIN))
+#ifdef ENC28J60_INT_SUPPORT
+#  ifndef HAVE_ENC28J60_INT
+#    error "ENC28J60_INT pin not defined"
+#  endif
+    /* the INT line is held low as long as an enabled flag is set in EIR */
+    #define interrupt_occured() (! PIN_HIGH(ENC28J60_INT))
 #else
     #define interrupt_occured() 1
-    #define wol_interrupt_occured() 0
+#endif
+
+struct enc28j60_stats_t enc28j60_stats;
+
+#ifdef ENC28J60_INT_SUPPORT
+/* check the controller even if INT is not asserted, set if frames have
+ * been left in the buffer and periodically, since PKTIF does not reliably
+ * report pending frames (see errata #6) */
+uint8_t enc28j60_rx_check;
 #endif
 
 /* prototypes */
-void process_packet(void);
+uint8_t process_packet(void);
 
 
 
 void network_process(void)
 {
+#ifdef ENC28J60_INT_SUPPORT
+    /* don't touch the controller via spi, if there is nothing to do */
+    if (!interrupt_occured() && !enc28j60_rx_check)
+        return;
+
+    enc28j60_rx_check = 0;
+#endif
+
     /* also check packet counter, see errata #6 */
 #   ifdef ENC28J60_REV4_WORKAROUND
     uint8_t pktcnt = read_control_register(REG_EPKTCNT);
+#   else
+    uint8_t pktcnt = 0;
 #   endif
 
-    /* if no interrupt occured and no packets are in the receive
-     * buffer, return */
-    if ( !interrupt_occured()
-#   ifdef ENC28J60_REV4_WORKAROUND
-                || pktcnt == 0
-#   endif
-           )
+#   if defined(ENC28J60_REV4_WORKAROUND) && !defined(ENC28J60_INT_SUPPORT)
+    /* if no packets are in the receive buffer, only start the next frame
+     * to be transmitted and return */
+    if (pktcnt == 0) {
+        enc28j60_tx_kick();
         return;
+    }
+#   endif
 
 #   if defined(ENC28J60_REV4_WORKAROUND) && defined(DEBUG_REV4_WORKAROUND)
     if (pktcnt > 5)
@@ -132,16 +151,28 @@ void network_process(void)
 
     /* packet receive flag */
     if ( (EIR & _BV(PKTIF)) || pktcnt ) {
-      if (uip_buf_lock ())
-	return;			/* already locked */
+      if (uip_buf_lock ()) {
+#ifdef ENC28J60_INT_SUPPORT
+	enc28j60_rx_check = 1;	/* already locked, try again next time */
+#endif
+      } else {
+	/* drain the receive buffer, but leave some time to the others */
+	uint8_t budget = ENC28J60_RX_BUDGET;
 
-      process_packet();
-      uip_buf_unlock ();
+	while (process_packet() && --budget);
+	uip_buf_unlock ();
+
+#ifdef ENC28J60_INT_SUPPORT
+	if (budget == 0)
+	  enc28j60_rx_check = 1;
+#endif
+      }
     }
 
-    /* receive error */
+    /* receive error, the receive buffer is full and frames get lost */
     if (EIR & _BV(RXERIF)) {
         debug_printf("net: receive error!\n");
+        enc28j60_stats.rx_overflow++;
 
         bit_field_clear(REG_EIR, _BV(RXERIF));
 
@@ -162,31 +193,44 @@ void network_process(void)
         bit_field_clear(REG_EIR, _BV(TXERIF));
     }
 
+    /* start the next frame, if the previous one has been transmitted; not
+     * before TXIF has been cleared above, since the TXIF of a frame started
+     * earlier could be cleared unhandled and the queue would stall until
+     * the periodic check */
+    enc28j60_tx_kick();
+
     /* set global interrupt flag */
     bit_field_set(REG_EIE, _BV(INTIE));
 }
 
 
-void process_packet(void)
+/* process one frame from the receive buffer, return 0 if there was none
+ * (or the controller had to be reset) */
+uint8_t process_packet(void)
 {
     /* if there is a packet to process */
     if (read_control_register(REG_EPKTCNT) == 0)
-        return;
+        return 0;
 
 #   ifdef DEBUG_NET
     debug_printf("net: packet received\n");
 #   endif
 
+#ifdef ENC28J60_DMA_CHKSUM_SUPPORT
+    /* the frame follows next packet pointer and receive status vector */
+    uint16_t frame = RECEIVE_BUFFER_WRAP(enc28j60_next_packet_pointer
+            + sizeof(uint16_t) + sizeof(struct receive_packet_vector_t));
+#endif
+
     /* read next packet pointer */
+    uint16_t next_packet_pointer;
     set_read_buffer_pointer(enc28j60_next_packet_pointer);
-    enc28j60_next_packet_pointer = read_buffer_memory() | (read_buffer_memory() << 8);
+    read_buffer_memory_block(&next_packet_pointer, sizeof(next_packet_pointer));
+    enc28j60_next_packet_pointer = next_packet_pointer;
 
     /* read receive status vector */
     struct receive_packet_vector_t rpv;
-    uint8_t *p = (uint8_t *)&rpv;
-
-    for (uint8_t i = 0; i < sizeof(struct receive_packet_vector_t); i++)
-        *p++ = read_buffer_memory();
+    read_buffer_memory_block(&rpv, sizeof(struct receive_packet_vector_t));
 
     /* decrement rpv received_packet_size by 4, because the 4 byte CRC checksum is counted */
     rpv.received_packet_size -= 4;
@@ -199,14 +243,15 @@ void process_packet(void)
         debug_printf("net: packet too large or too small for an "
 		     "ethernet header: %d\n", rpv.received_packet_size);
 #       endif
+        enc28j60_stats.rx_error++;
 	init_enc28j60();
-        return;
+        return 0;
     }
 
+    enc28j60_stats.rx++;
+
     /* read packet */
-    p = uip_buf;
-    for (uint16_t i = 0; i < rpv.received_packet_size; i++)
-        *p++ = read_buffer_memory();
+    read_buffer_memory_block(uip_buf, rpv.received_packet_size);
 
     uip_len = rpv.received_packet_size;
 
@@ -258,7 +303,14 @@ void process_packet(void)
             uip_arp_ipin();
 #       endif /* !UIP_CONF_IPV6 */
 
+#ifdef ENC28J60_DMA_CHKSUM_SUPPORT
+            /* uip may let the dma sum up the frame, while it is unchanged */
+            enc28j60_rx_frame = frame;
             router_input(STACK_ENC);
+            enc28j60_rx_frame = 0xffff;
+#else
+            router_input(STACK_ENC);
+#endif
 
 	    /* if there is a packet to send, send it now */
 	    if (uip_len > 0)
@@ -307,4 +359,5 @@ void process_packet(void)
     /* decrement packet counter */
     bit_field_set(REG_ECON2, _BV(PKTDEC));
 
+    return 1;
 }
@@ -30,6 +30,56 @@
 #include "core/debug.h"
 
 
+/* frames in the transmit slots, the one in tx_head is transmitted as soon
+ * as enc28j60_tx_started is set, the others are waiting for it */
+uint8_t enc28j60_tx_queued;
+uint8_t enc28j60_tx_started;
+
+static uint8_t tx_head;
+static uint16_t tx_len[TXBUFFER_SLOTS];
+
+#define TX_SLOT(n) (TXBUFFER_START + (n) * TXBUFFER_SLOT_SIZE)
+
+
+void enc28j60_tx_kick(void)
+{
+    if (enc28j60_tx_queued == 0)
+        return;
+
+    if (enc28j60_tx_started) {
+        /* still transmitting */
+        if (read_control_register(REG_ECON1) & _BV(ECON1_TXRTS))
+            return;
+
+        /* done (or aborted), free the slot */
+        enc28j60_tx_started = 0;
+        tx_head = (tx_head + 1) % TXBUFFER_SLOTS;
+
+        if (--enc28j60_tx_queued == 0)
+            return;
+    }
+
+    uint16_t start_pointer = TX_SLOT(tx_head);
+
+    /* set send control registers */
+    write_control_register(REG_ETXSTL, LO8(start_pointer));
+    write_control_register(REG_ETXSTH, HI8(start_pointer));
+
+    write_control_register(REG_ETXNDL, LO8(start_pointer + tx_len[tx_head]));
+    write_control_register(REG_ETXNDH, HI8(start_pointer + tx_len[tx_head]));
+
+#   ifdef ENC28J60_REV4_WORKAROUND
+    /* reset transmit hardware, see errata #12 */
+    bit_field_set(REG_ECON1, _BV(ECON1_TXRST));
+    bit_field_clear(REG_ECON1, _BV(ECON1_TXRST));
+#   endif
+
+    /* transmit packet */
+    bit_field_set(REG_ECON1, _BV(ECON1_TXRTS));
+    enc28j60_tx_started = 1;
+}
+
+
 void transmit_packet(void)
 {
 #ifdef IEEE8021Q_SUPPORT
@@ -40,41 +90,34 @@ void transmit_packet(void)
     eh->vid_lo = CONF_8021Q_VID & 0xFF;
 #endif
 
-    /* wait for any transmits to end, with timeout */
+    /* if all slots are in use, wait for a transmit to end, with timeout */
     uint8_t timeout = 100;
-    while (read_control_register(REG_ECON1) & _BV(ECON1_TXRTS) && timeout-- > 0);
+    do
+        enc28j60_tx_kick();
+    while (enc28j60_tx_queued == TXBUFFER_SLOTS && timeout-- > 0);
 
-    if (timeout == 0) {
+    if (enc28j60_tx_queued == TXBUFFER_SLOTS) {
         debug_printf("net: timeout waiting for TXRTS, aborting transmit!\n");
+        enc28j60_stats.tx_drop++;
         return;
     }
 
-    uint16_t start_pointer = TXBUFFER_START;
-
-    /* set send control registers */
-    write_control_register(REG_ETXSTL, LO8(start_pointer));
-    write_control_register(REG_ETXSTH, HI8(start_pointer));
-
-    write_control_register(REG_ETXNDL, LO8(start_pointer + uip_len));
-    write_control_register(REG_ETXNDH, HI8(start_pointer + uip_len));
+    /* append to the queue */
+    uint8_t slot = (tx_head + enc28j60_tx_queued) % TXBUFFER_SLOTS;
 
-    /* set pointer to beginning of tx buffer */
-    set_write_buffer_pointer(start_pointer);
+    /* set pointer to beginning of the slot */
+    set_write_buffer_pointer(TX_SLOT(slot));
 
     /* write override byte */
     write_buffer_memory(0);
 
     /* write data */
-    for (uint16_t i = 0; i < uip_len; i++)
-        write_buffer_memory(uip_buf[i]);
-
-#   ifdef ENC28J60_REV4_WORKAROUND
-    /* reset transmit hardware, see errata #12 */
-    bit_field_set(REG_ECON1, _BV(ECON1_TXRST));
-    bit_field_clear(REG_ECON1, _BV(ECON1_TXRST));
-#   endif
+    write_buffer_memory_block(uip_buf, uip_len);
 
-    /* transmit packet */
-    bit_field_set(REG_ECON1, _BV(ECON1_TXRTS));
+    tx_len[slot] = uip_len;
+    enc28j60_tx_queued++;
+    enc28j60_stats.tx++;
 
+    /* transmit it now, if the controller is idle */
+    enc28j60_tx_kick();
 }
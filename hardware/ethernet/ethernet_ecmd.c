@@ -29,6 +29,7 @@
 #include "protocols/uip/uip.h"
 #include "protocols/uip/parse.h"
 #include "core/eeprom.h"
+#include "hardware/ethernet/enc28j60.h"
 
 #include "protocols/ecmd/ecmd-base.h"
 
@@ -115,6 +116,21 @@ int16_t parse_cmd_mac(char *cmd, char *output, uint16_t len)
     }
 }
 
+#ifdef ENC28J60_SUPPORT
+int16_t parse_cmd_enc_stats(char *cmd, char *output, uint16_t len)
+{
+    (void) cmd;
+
+    return ECMD_FINAL(snprintf_P(output, len,
+                                 PSTR("rx %u error %u overflow %u, "
+                                      "tx %u drop %u queued %u/%u"),
+                                 enc28j60_stats.rx, enc28j60_stats.rx_error,
+                                 enc28j60_stats.rx_overflow,
+                                 enc28j60_stats.tx, enc28j60_stats.tx_drop,
+                                 enc28j60_tx_queued, TXBUFFER_SLOTS));
+}
+#endif /* ENC28J60_SUPPORT */
+
 
 /*
   -- Ethersex META --
@@ -123,5 +139,8 @@ int16_t parse_cmd_mac(char *cmd, char *output, uint16_t len)
   ecmd_ifdef(DEBUG_ENC28J60)
     ecmd_feature(enc_dump, "enc dump", , Dump the internal state of the enc to serial)
   ecmd_endif()
+  ecmd_ifdef(ENC28J60_SUPPORT)
+    ecmd_feature(enc_stats, "enc stats",, Display receive and transmit statistics of the enc28j60.)
+  ecmd_endif()
     
 */
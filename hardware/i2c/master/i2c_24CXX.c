@@ -21,12 +21,14 @@
  */
 
 #include <avr/io.h>
+#include <string.h>
 #include <util/twi.h>
         
 #include "config.h"
 #include "core/debug.h"
 #include "core/bit-macros.h"
 #include "i2c_master.h"
+#include "i2c_queue.h"
 #include "i2c_24CXX.h"
 
 static uint8_t i2c_24cxx_address;
@@ -57,6 +59,57 @@ end:
   return ret;
 }
 
+#ifdef I2C_QUEUE_SUPPORT
+
+/* The chip doesn't acknowledge its address during a write cycle, every
+   transaction is retried long enough to cover one.  This way a write
+   returns as soon as the data is sent, the next access waits. */
+#define I2C_24CXX_RETRIES 500
+
+static void
+i2c_24CXX_setup(struct i2c_transaction *t, uint16_t addr)
+{
+  *t = (struct i2c_transaction) {
+    .address = i2c_24cxx_address,
+    .buflen = 2,
+    .buf = { HI8(addr), LO8(addr) },
+    .retries = I2C_24CXX_RETRIES,
+  };
+}
+
+uint8_t 
+i2c_24CXX_read_block(uint16_t addr, uint8_t *ptr, uint8_t len) 
+{
+  struct i2c_transaction t;
+#ifdef DEBUG_I2C
+  debug_printf("read %i bytes at address: %i \r\n", len, addr);
+#endif
+
+  i2c_24CXX_setup(&t, addr);
+  t.rlen = len;
+  t.rdata = ptr;
+  return i2c_queue_run(&t) == I2C_DONE ? len : 0;
+}
+
+uint8_t 
+i2c_24CXX_write_block_int(uint16_t addr, uint8_t *ptr, uint8_t len)
+{
+  struct i2c_transaction t;
+
+  i2c_24CXX_setup(&t, addr);
+  t.wlen = len;
+  t.wdata = ptr;
+  if (i2c_queue_run(&t) != I2C_DONE) {
+#ifdef DEBUG_I2C
+    debug_printf("NOT WRITTEN!!\r\n");
+#endif
+    return 0;
+  }
+  return len;
+}
+
+#else /* I2C_QUEUE_SUPPORT */
+
 uint8_t 
 i2c_24CXX_read_block(uint16_t addr, uint8_t *ptr, uint8_t len) 
 {
@@ -134,6 +187,8 @@ end:
   return ret;
 }
 
+#endif /* I2C_QUEUE_SUPPORT */
+
 uint8_t i2c_24CXX_write_block(uint16_t addr, uint8_t *ptr, uint8_t len) {
 	uint8_t ret;
 	uint8_t templen;
@@ -162,6 +217,26 @@ i2c_24CXX_write_byte(uint16_t addr, uint8_t data)
   return i2c_24CXX_write_block(addr, &data, 1);
 }
 
+#ifdef I2C_QUEUE_SUPPORT
+
+uint8_t 
+i2c_24CXX_compare_block(uint16_t addr, uint8_t *ptr, uint8_t len) 
+{
+  uint8_t buf[16];
+
+  while (len) {
+    uint8_t n = len < sizeof(buf) ? len : sizeof(buf);
+    if (i2c_24CXX_read_block(addr, buf, n) != n) return 0;
+    if (memcmp(buf, ptr, n)) return 0;
+    addr += n;
+    ptr += n;
+    len -= n;
+  }
+  return 1;
+}
+
+#else /* I2C_QUEUE_SUPPORT */
+
 uint8_t 
 i2c_24CXX_compare_block(uint16_t addr, uint8_t *ptr, uint8_t len) 
 {
@@ -193,6 +268,8 @@ end:
   return ret;
 }
 
+#endif /* I2C_QUEUE_SUPPORT */
+
 /*
   -- Ethersex META --
   header(hardware/i2c/master/i2c_24CXX.h)
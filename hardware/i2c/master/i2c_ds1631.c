@@ -29,9 +29,82 @@
 #include "config.h"
 #include "core/debug.h"
 #include "i2c_master.h"
+#include "i2c_ds1631.h"
 
 #ifdef I2C_DS1631_SUPPORT
 
+#ifdef I2C_QUEUE_SUPPORT
+
+uint16_t i2c_ds1631_start_stop(const uint8_t chipaddress, const uint8_t startstop)
+{
+	struct i2c_transaction t = {
+		.address = chipaddress,
+		.buflen = 1,
+		.buf = { startstop == 0 ? 0x22 : 0x51 }, // start/stop convert T command
+	};
+
+	return i2c_queue_run(&t) == I2C_DONE ? 0x0 : 0xffff;
+}
+
+static void i2c_ds1631_setup(struct i2c_transaction *t, const uint8_t chipaddress)
+{
+	*t = (struct i2c_transaction) {
+		.address = chipaddress,
+		.buflen = 1,
+		.buf = { 0xAA }, // read last converted temperature
+		.rlen = 2,
+		.rdata = t->buf,
+	};
+}
+
+uint16_t i2c_ds1631_temperature(struct i2c_transaction *t, int16_t *temp, int16_t *stemp)
+{
+	if (t->status != I2C_DONE)
+	{
+		return 0xffff;
+	}
+
+#ifdef DEBUG_I2C
+	debug_printf("I2C: i2c_ds1631_read_temp: msb 0x%X lsb 0x%X\n",t->buf[0],t->buf[1]);
+#endif
+
+	if (t->buf[0] & 0x80)
+	{
+		*temp = (128 - (t->buf[0] & 0x7F));
+		*temp *= -1;
+	}
+	else
+	{
+		*temp = t->buf[0];
+	}
+
+	*stemp = ((t->buf[1] >> 4) * 625);
+
+#ifdef DEBUG_I2C
+	debug_printf("I2C: i2c_ds1631_read_temp: temp: %d.%d\n",*temp,*stemp);
+#endif
+
+	return 0x0;
+}
+
+void i2c_ds1631_read_temperature_async(struct i2c_transaction *t, const uint8_t chipaddress, i2c_callback_t callback)
+{
+	i2c_ds1631_setup(t, chipaddress);
+	t->callback = callback;
+	i2c_queue_submit(t);
+}
+
+uint16_t i2c_ds1631_read_temperature(const uint8_t chipaddress, int16_t *temp, int16_t *stemp)
+{
+	struct i2c_transaction t;
+
+	i2c_ds1631_setup(&t, chipaddress);
+	i2c_queue_run(&t);
+	return i2c_ds1631_temperature(&t, temp, stemp);
+}
+
+#else /* I2C_QUEUE_SUPPORT */
+
 uint16_t i2c_ds1631_start_stop(const uint8_t chipaddress, const uint8_t startstop)
 {
 	uint16_t ret = 0xffff;
@@ -134,4 +207,6 @@ end:
 	return ret;
 }
 
+#endif /* I2C_QUEUE_SUPPORT */
+
 #endif /* I2C_DS1631_SUPPORT */
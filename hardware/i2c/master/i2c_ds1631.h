@@ -29,4 +29,12 @@
 uint16_t i2c_ds1631_start_stop(const uint8_t address, const uint8_t startstop); // startstop == 0 -> stop, all other -> start
 uint16_t i2c_ds1631_read_temperature(const uint8_t address, int16_t *temp, int16_t *stemp);
 
+#include "i2c_queue.h"
+#ifdef I2C_QUEUE_SUPPORT
+/* Queue a temperature read, the callback gets the value from
+   i2c_ds1631_temperature(t, ...). */
+void i2c_ds1631_read_temperature_async(struct i2c_transaction *t, const uint8_t address, i2c_callback_t callback);
+uint16_t i2c_ds1631_temperature(struct i2c_transaction *t, int16_t *temp, int16_t *stemp);
+#endif
+
 #endif /* _I2C_DS1631_H */
@@ -28,9 +28,56 @@
 #include "config.h"
 #include "core/debug.h"
 #include "i2c_master.h"
+#include "i2c_lm75.h"
 
 #ifdef I2C_LM75_SUPPORT
 
+#ifdef I2C_QUEUE_SUPPORT
+
+static void
+i2c_lm75_setup(struct i2c_transaction *t, uint8_t address)
+{
+  *t = (struct i2c_transaction) {
+    .address = address,
+    .rlen = 2,
+    .rdata = t->buf,
+  };
+}
+
+int16_t
+i2c_lm75_temp(struct i2c_transaction *t)
+{
+  if (t->status != I2C_DONE)
+    return 0xffff;
+#ifdef DEBUG_I2C
+  debug_printf("I2C: lm75 read value: %d %d\n", t->buf[0], t->buf[1]);
+#endif
+  return ( (t->buf[0] << 8) | (t->buf[1] & 0x80) ) / 128*5;
+}
+
+void
+i2c_lm75_read_temp_async(struct i2c_transaction *t, uint8_t address,
+                         i2c_callback_t callback)
+{
+  i2c_lm75_setup(t, address);
+  t->callback = callback;
+  i2c_queue_submit(t);
+}
+
+int16_t
+i2c_lm75_read_temp(uint8_t address){
+  struct i2c_transaction t;
+
+#ifdef DEBUG_I2C
+  debug_printf("I2C: lm75 read\n");
+#endif
+  i2c_lm75_setup(&t, address);
+  i2c_queue_run(&t);
+  return i2c_lm75_temp(&t);
+}
+
+#else /* I2C_QUEUE_SUPPORT */
+
 int16_t
 i2c_lm75_read_temp(uint8_t address){
   uint8_t temp[2];
@@ -59,4 +106,6 @@ end:
   return ret;
 }
 
+#endif /* I2C_QUEUE_SUPPORT */
+
 #endif /* I2C_LM75_SUPPORT */
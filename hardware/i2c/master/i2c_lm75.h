@@ -29,4 +29,13 @@
 
 int16_t i2c_lm75_read_temp(uint8_t address);
 
+#include "i2c_queue.h"
+#ifdef I2C_QUEUE_SUPPORT
+/* Queue a temperature read, the callback gets the value from
+   i2c_lm75_temp(t). */
+void i2c_lm75_read_temp_async(struct i2c_transaction *t, uint8_t address,
+                              i2c_callback_t callback);
+int16_t i2c_lm75_temp(struct i2c_transaction *t);
+#endif
+
 #endif /* _I2C_LM75_H */
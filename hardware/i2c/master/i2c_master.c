@@ -23,6 +23,7 @@
 #include "config.h"
 #include "core/debug.h"
 #include "i2c_master.h"
+#include "i2c_queue.h"
 
 void
 i2c_master_init(void)
@@ -80,6 +81,10 @@ i2c_master_stop(void)
 uint8_t
 i2c_master_select(uint8_t address, uint8_t mode)
 {
+#ifdef I2C_QUEUE_SUPPORT
+  /* don't interfere with queued transactions */
+  i2c_queue_wait_idle();
+#endif
   i2c_master_enable();
   #ifdef DEBUG_I2C
     debug_printf("i2c master select adr+mode 0x%X\n", (address << 1) | mode);
@@ -37,6 +37,96 @@
   | ivrt    | 1 | inverted pwm output (LED ON means PIN is low)      |
   | ---------------------------------------------------------------- |
  */
+#ifdef I2C_QUEUE_SUPPORT
+uint8_t i2c_pca9685_reset()
+{
+	/*ALL CALL Address = 0b0000 0000*/
+	struct i2c_transaction t = {
+		.address = 0x00,
+		.buflen = 1,
+		.buf = { 0x06 }, //magic reset byte
+	};
+	return i2c_queue_run(&t) == I2C_DONE ? 0 : 1;
+}
+uint8_t i2c_pca9685_set_mode(uint8_t address,uint8_t outdrv,uint8_t ivrt,uint8_t prescaler)
+{
+#ifdef PCA9685_OUTPUT_ENABLE
+        PCA9685_OE_DDR |= (1<<PCA9685_OE_PIN);
+#endif
+	if(i2c_pca9685_reset() != 0)
+		return 1;
+	/*The chip is in sleep mode on power up..let's wake it up
+	  Settings are: Auto-Increment: true ALLCALL: true
+	 */
+	struct i2c_transaction t[3] = {
+		{ .address = address, .buflen = 2, .buf = { PRE_SCALE, prescaler } },
+		{ .address = address, .buflen = 2, .buf = { MODE2, (outdrv << 2) | (ivrt << 4) } },
+		{ .address = address, .buflen = 2, .buf = { MODE1, 0b00100001 } },
+	};
+#ifdef DEBUG_I2C
+	debug_printf("I2C: PCA9685 writing mode %d,%d,%d\n", t[0].buf[1], t[1].buf[1], t[2].buf[1]);
+#endif
+	/*The queue runs in order, when the last one is done all are*/
+	i2c_queue_submit(&t[0]);
+	i2c_queue_submit(&t[1]);
+	i2c_queue_run(&t[2]);
+	return (t[0].status | t[1].status | t[2].status) == I2C_DONE ? 0 : 1; //0 if everything went fine, 1 if one transmit failed
+}
+uint8_t i2c_pca9685_set_led(uint8_t address,uint8_t led,uint16_t on, uint16_t off)
+{
+	uint8_t data[4] = { LO8(on), HI8(on), LO8(off), HI8(off) };
+	struct i2c_transaction t = {
+		.address = address,
+		.buflen = 1,
+		.buf = { LED0_ON_L+4*led-1 }, //Address of LED REGISTER low byte of the word
+		.wlen = sizeof(data),
+		.wdata = data,
+	};
+#ifdef DEBUG_I2C
+	debug_printf("I2C: PCA9685 writing to chip %x setting led %d to %d,%d\n", address,led,on,off);
+#endif
+	return i2c_queue_run(&t) == I2C_DONE ? 0 : 1; //0 if everything went fine, 1 if one transmit failed
+}
+static void i2c_pca9685_setup_leds(struct i2c_transaction *t, uint8_t address, uint8_t startled, uint8_t count,uint16_t *values)
+{
+	/*values are sent as stored, i.e. low byte first*/
+	*t = (struct i2c_transaction) {
+		.address = address,
+		.buflen = 1,
+		.buf = { LED0_ON_L+4*startled-1 }, //Address of LED REGISTER
+		.wlen = 2*count,
+		.wdata = (const uint8_t *) values,
+	};
+}
+void i2c_pca9685_set_leds_async(struct i2c_transaction *t, uint8_t address, uint8_t startled, uint8_t count,uint16_t *values)
+{
+	i2c_pca9685_setup_leds(t, address, startled, count, values);
+	i2c_queue_submit(t);
+}
+uint8_t i2c_pca9685_set_leds(uint8_t address, uint8_t startled, uint8_t count,uint16_t *values)
+{
+	struct i2c_transaction t;
+	i2c_pca9685_setup_leds(&t, address, startled, count, values);
+	return i2c_queue_run(&t) == I2C_DONE ? 0 : 1;
+}
+uint8_t i2c_pca9685_set_leds_fast(uint8_t address, uint8_t startled, uint8_t count,uint16_t *values)
+{
+	struct i2c_transaction t;
+	for(uint8_t i=0;i<count;i++) /*One transaction per LED, the ON value is set to 0*/
+	{
+		t = (struct i2c_transaction) {
+			.address = address,
+			.buflen = 3,
+			.buf = { LED0_ON_L+4*(startled+i)-1, 0x00, 0x00 },
+			.wlen = 2,
+			.wdata = (const uint8_t *) &values[i],
+		};
+		if(i2c_queue_run(&t) != I2C_DONE)
+			return 1;
+	}
+	return count ? 0 : 1;
+}
+#else /* I2C_QUEUE_SUPPORT */
 uint8_t i2c_pca9685_reset()
 {
 	uint8_t ret=1;
@@ -256,6 +346,7 @@ uint8_t i2c_pca9685_set_leds_fast(uint8_t address, uint8_t startled, uint8_t cou
 	i2c_master_stop();
 	return ret;
 }
+#endif /* I2C_QUEUE_SUPPORT */
 #ifdef PCA9685_OUTPUT_ENABLE
 void i2c_pca9685_output_enable(enum i2c_pca9685_output_enable_state choice)
 {
@@ -41,6 +41,11 @@ uint8_t i2c_pca9685_set_mode(uint8_t address,uint8_t outdrv,uint8_t ivrt,uint8_t
 uint8_t i2c_pca9685_set_led(uint8_t address,uint8_t led,uint16_t on, uint16_t off);
 uint8_t i2c_pca9685_set_leds(uint8_t address, uint8_t startled, uint8_t count,uint16_t *values);
 uint8_t i2c_pca9685_set_leds_fast(uint8_t address, uint8_t startled, uint8_t count,uint16_t *values);
+#include "i2c_queue.h"
+#ifdef I2C_QUEUE_SUPPORT
+/* Queue setting count values, values must not change until the status of t is no longer I2C_PENDING */
+void i2c_pca9685_set_leds_async(struct i2c_transaction *t, uint8_t address, uint8_t startled, uint8_t count,uint16_t *values);
+#endif
 #ifdef PCA9685_OUTPUT_ENABLE
 enum i2c_pca9685_output_enable_state{ON,OFF,TOGGLE};
 void i2c_pca9685_output_enable(enum i2c_pca9685_output_enable_state choice);
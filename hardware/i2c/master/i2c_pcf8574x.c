@@ -26,9 +26,59 @@
 #include "config.h"
 #include "core/debug.h"
 #include "i2c_master.h"
+#include "i2c_pcf8574x.h"
 
 #ifdef I2C_PCF8574X_SUPPORT
 
+#ifdef I2C_QUEUE_SUPPORT
+
+int8_t
+i2c_pcf8574x_read(uint8_t address){
+  struct i2c_transaction t = {
+    .address = address,
+    .rlen = 1,
+    .rdata = t.buf,
+  };
+
+#ifdef DEBUG_I2C
+  debug_printf("I2C: pcf8574X read\n");
+#endif
+  if (i2c_queue_run(&t) != I2C_DONE)
+    return 0xff;
+#ifdef DEBUG_I2C
+  debug_printf("I2C: pcf8574X read value: %X\n", t.buf[0]);
+#endif
+  return t.buf[0];
+}
+
+static void
+i2c_pcf8574x_setup(struct i2c_transaction *t, uint8_t address, uint8_t value){
+#ifdef DEBUG_I2C
+  debug_printf("I2C: pcf8574X set value: %X\n", value);
+#endif
+  *t = (struct i2c_transaction) {
+    .address = address,
+    .buflen = 1,
+    .buf = { value },
+  };
+}
+
+void
+i2c_pcf8574x_set_async(struct i2c_transaction *t, uint8_t address, uint8_t value){
+  i2c_pcf8574x_setup(t, address, value);
+  i2c_queue_submit(t);
+}
+
+int16_t
+i2c_pcf8574x_set(uint8_t address, uint8_t value){
+  struct i2c_transaction t;
+
+  i2c_pcf8574x_setup(&t, address, value);
+  return i2c_queue_run(&t) == I2C_DONE ? 0 : 0xffff;
+}
+
+#else /* I2C_QUEUE_SUPPORT */
+
 int8_t
 i2c_pcf8574x_read(uint8_t address){
   uint8_t data[2];
@@ -78,4 +128,6 @@ i2c_pcf8574x_set(uint8_t address, uint8_t value){
   return ret;
 }
 
+#endif /* I2C_QUEUE_SUPPORT */
+
 #endif /* I2C_PCF8574X_SUPPORT */
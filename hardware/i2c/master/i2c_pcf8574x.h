@@ -29,4 +29,11 @@
 int8_t i2c_pcf8574x_read(uint8_t address);
 int16_t i2c_pcf8574x_set(uint8_t address, uint8_t value);
 
+#include "i2c_queue.h"
+#ifdef I2C_QUEUE_SUPPORT
+/* Queue setting the port, T may be reused once its status is no
+   longer I2C_PENDING. */
+void i2c_pcf8574x_set_async(struct i2c_transaction *t, uint8_t address, uint8_t value);
+#endif
+
 #endif /* _I2C_PCF8574X_H */
@@ -0,0 +1,204 @@
+/*
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <stddef.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/twi.h>
+
+#include "config.h"
+#include "i2c_queue.h"
+
+#define TWCR_GO		(_BV(TWINT) | _BV(TWEN) | _BV(TWIE))
+
+/* Transactions waiting for the bus, the head is the active one. */
+static struct i2c_transaction * volatile queue_head;
+static struct i2c_transaction *queue_tail;
+
+/* Finished transactions waiting for their callback. */
+static struct i2c_transaction * volatile done_head;
+static struct i2c_transaction *done_tail;
+
+/* Bytes transferred in the current phase of the active transaction. */
+static uint16_t pos;
+
+
+static void
+i2c_queue_finish (uint8_t status)
+{
+  struct i2c_transaction *t = queue_head;
+  queue_head = t->next;
+
+  if (t->callback)
+    {
+      /* T stays pending until its callback has been dispatched, the
+	 owner must not resubmit it while it is on the done list. */
+      t->result = status;
+      t->next = NULL;
+      if (done_head)
+	done_tail->next = t;
+      else
+	done_head = t;
+      done_tail = t;
+    }
+  else
+    /* The owner may reuse T as soon as it sees the new status. */
+    t->status = status;
+
+  if (queue_head)
+    TWCR = TWCR_GO | _BV(TWSTO) | _BV(TWSTA);
+  else
+    TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWSTO);
+}
+
+
+ISR (TWI_vect)
+{
+  struct i2c_transaction *t = queue_head;
+
+  switch (TW_STATUS)
+    {
+    case TW_START:
+      pos = 0;
+      if (t->buflen || t->wlen || !t->rlen)
+	TWDR = (t->address << 1) | TW_WRITE;
+      else
+	TWDR = (t->address << 1) | TW_READ;
+      TWCR = TWCR_GO;
+      break;
+
+    case TW_REP_START:
+      pos = 0;
+      TWDR = (t->address << 1) | TW_READ;
+      TWCR = TWCR_GO;
+      break;
+
+    case TW_MT_SLA_ACK:
+    case TW_MT_DATA_ACK:
+      if (pos < t->buflen)
+	TWDR = t->buf[pos];
+      else if (pos - t->buflen < t->wlen)
+	TWDR = t->wdata[pos - t->buflen];
+      else if (t->rlen)
+	{
+	  TWCR = TWCR_GO | _BV(TWSTA);
+	  break;
+	}
+      else
+	{
+	  i2c_queue_finish (I2C_DONE);
+	  break;
+	}
+      pos ++;
+      TWCR = TWCR_GO;
+      break;
+
+    case TW_MR_DATA_ACK:
+      t->rdata[pos ++] = TWDR;
+      /* fall through */
+    case TW_MR_SLA_ACK:
+      /* Acknowledge all but the last byte. */
+      if (pos + 1 < t->rlen)
+	TWCR = TWCR_GO | _BV(TWEA);
+      else
+	TWCR = TWCR_GO;
+      break;
+
+    case TW_MR_DATA_NACK:
+      t->rdata[pos] = TWDR;
+      i2c_queue_finish (I2C_DONE);
+      break;
+
+    case TW_MT_SLA_NACK:
+    case TW_MR_SLA_NACK:
+      if (t->retries)
+	{
+	  t->retries --;
+	  TWCR = TWCR_GO | _BV(TWSTO) | _BV(TWSTA);
+	}
+      else
+	i2c_queue_finish (I2C_NACK);
+      break;
+
+    default:
+      i2c_queue_finish (I2C_ERROR);
+      break;
+    }
+}
+
+
+void
+i2c_queue_submit (struct i2c_transaction *t)
+{
+  t->next = NULL;
+  t->status = I2C_PENDING;
+
+  uint8_t sreg = SREG; cli ();
+  if (queue_head)
+    queue_tail->next = t;
+  else
+    {
+      queue_head = t;
+      while (TWCR & _BV(TWSTO));	/* previous stop still running */
+      TWCR = TWCR_GO | _BV(TWSTA);
+    }
+  queue_tail = t;
+  SREG = sreg;
+}
+
+
+uint8_t
+i2c_queue_run (struct i2c_transaction *t)
+{
+  t->callback = NULL;
+  i2c_queue_submit (t);
+  while (t->status == I2C_PENDING);
+  return t->status;
+}
+
+
+void
+i2c_queue_wait_idle (void)
+{
+  while (queue_head);
+  while (TWCR & _BV(TWSTO));
+}
+
+
+void
+i2c_queue_process (void)
+{
+  while (done_head)
+    {
+      uint8_t sreg = SREG; cli ();
+      struct i2c_transaction *t = done_head;
+      done_head = t->next;
+      SREG = sreg;
+
+      t->status = t->result;
+      t->callback (t);
+    }
+}
+
+/*
+  -- Ethersex META --
+  header(hardware/i2c/master/i2c_queue.h)
+  mainloop(i2c_queue_process)
+*/
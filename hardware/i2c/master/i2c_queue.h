@@ -0,0 +1,84 @@
+/*
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef _I2C_QUEUE_H
+#define _I2C_QUEUE_H
+
+#include "config.h"
+#ifdef I2C_QUEUE_SUPPORT
+
+#include <stdint.h>
+
+/* Transaction status.  A zero initialized transaction counts as
+   finished, so it may be checked before it was submitted the first
+   time. */
+#define I2C_DONE	0
+#define I2C_NACK	1	/* slave address not acknowledged */
+#define I2C_ERROR	2	/* data not acknowledged or bus error */
+#define I2C_PENDING	3	/* queued or on the bus */
+
+struct i2c_transaction;
+typedef void (*i2c_callback_t) (struct i2c_transaction *);
+
+/* One bus transaction, owned by the caller and handed to the TWI
+   interrupt until its status is no longer I2C_PENDING:
+
+     START, SLA+W, buf[0..buflen), wdata[0..wlen),
+       repeated START, SLA+R, rdata[0..rlen), STOP
+
+   The write phase is skipped if buflen and wlen are zero and rlen is
+   not, the read phase is skipped if rlen is zero.  rdata may point to
+   buf, it is only written after buf has been sent.  If the slave does
+   not acknowledge its address, the transaction is restarted up to
+   retries times (acknowledge polling).  A transaction with a callback
+   stays I2C_PENDING until its callback is run, so it may be
+   resubmitted from the callback, but not before. */
+struct i2c_transaction {
+  struct i2c_transaction *next;
+  uint8_t address;
+  volatile uint8_t status;
+  uint8_t buflen;
+  uint8_t buf[4];
+  uint8_t wlen;
+  const uint8_t *wdata;
+  uint8_t rlen;
+  uint8_t *rdata;
+  uint16_t retries;
+  i2c_callback_t callback;
+  uint8_t result;		/* internal, status until the callback */
+};
+
+/* Append T to the queue.  The callback, if any, is run from the
+   mainloop after the transaction has finished, T's status is set
+   right before.  Must not be called from interrupt context. */
+void i2c_queue_submit (struct i2c_transaction *t);
+
+/* Submit T and wait for it to finish, returns its status. */
+uint8_t i2c_queue_run (struct i2c_transaction *t);
+
+/* Wait until the queue is empty and the bus is released, to be called
+   before accessing the TWI registers directly. */
+void i2c_queue_wait_idle (void);
+
+/* Run the callbacks of finished transactions. */
+void i2c_queue_process (void);
+
+#endif /* I2C_QUEUE_SUPPORT */
+#endif /* _I2C_QUEUE_H */
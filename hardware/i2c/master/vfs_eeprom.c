@@ -201,7 +201,10 @@ vfs_eeprom_open(const char * filename)
     return NULL;
 
   struct vfs_file_handle_t *handle = malloc(sizeof(struct vfs_file_handle_t));
-  if (!handle) return NULL;
+  if (!handle) {
+    vfs_open_error();
+    return NULL;
+  }
   handle->fh_type = VFS_EEPROM;
   handle->u.ee.file_page = inode;
   handle->u.ee.offset = 0;
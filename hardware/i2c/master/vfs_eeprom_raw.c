@@ -34,8 +34,10 @@ vfs_eeprom_raw_open (const char *filename)
 {
   if (isdigit(filename[0])) {
     struct vfs_file_handle_t *fh = malloc (sizeof (struct vfs_file_handle_t));
-    if (fh == NULL)
+    if (fh == NULL) {
+      vfs_open_error ();
       return NULL;
+    }
 
     fh->fh_type = VFS_EEPROM_RAW;
     fh->u.ee_raw.inode = atoi(filename);
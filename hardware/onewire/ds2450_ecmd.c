@@ -40,6 +40,10 @@ int8_t noinline ow_ecmd_parse_rom_arg(char **cmd, ow_rom_code_t **ptr_rom)
 {
 	int8_t ret;
 
+	/* somebody else (polling, "1w list") is using the bus */
+	if(ow_global.lock)
+		return ECMD_ERR_READ_ERROR;
+
 	while(**cmd == ' ')
 		(*cmd)++;
 
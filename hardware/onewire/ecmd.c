@@ -175,7 +175,7 @@ list_next: ;
     SREG = sreg;
 
     /* make sure only one conversion happens at a time */
-    ow_global.lock = 1;
+    ow_global.lock = OW_LOCK_TIMEOUT;
 
     if (ret == 1) {
 #ifdef ONEWIRE_DS2502_SUPPORT
@@ -285,6 +285,10 @@ int16_t parse_cmd_onewire_get(char *cmd, char *output, uint16_t len)
 	        return ECMD_FINAL(ret);
 #ifdef ONEWIRE_DS2502_SUPPORT
     } else if (ow_eeprom(&rom)) {
+        /* the polling engine is in the middle of a transaction */
+        if (ow_global.lock)
+            return ECMD_ERR_READ_ERROR;
+
         debug_printf("reading mac\n");
 
         /* disable interrupts */
@@ -340,6 +344,10 @@ int16_t parse_cmd_onewire_get(char *cmd, char *output, uint16_t len)
     if (ret < 0)
         return ECMD_ERR_PARSE_ERROR;
 
+    /* do not disturb a running "1w list" */
+    if (ow_global.lock)
+        return ECMD_ERR_READ_ERROR;
+
     if (ow_temp_sensor(&rom)) {
         debug_printf("reading temperature\n");
 
@@ -446,16 +454,16 @@ int16_t parse_cmd_onewire_convert(char *cmd, char *output, uint16_t len)
     /* check for romcode */
     romptr = (ret < 0) ? NULL : &rom;
 
-    debug_printf("converting temperature...\n");
+    /* do not disturb a running "1w list" */
+    if (ow_global.lock)
+        return ECMD_ERR_READ_ERROR;
 
-    /* disable interrupts */
-    uint8_t sreg = SREG;
-    cli();
+    debug_printf("converting temperature...\n");
 
+    /* the driver disables interrupts per time slot itself, no need to
+     * keep them off during the whole conversion */
     ret = ow_temp_start_convert_wait(romptr);
 
-    SREG = sreg;
-
     if (ret == 1)
         /* done */
         return ECMD_FINAL_OK;
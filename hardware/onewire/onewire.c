@@ -52,6 +52,13 @@ void onewire_init(void)
     ow_global.lock = 0;
 }
 
+/* called every 800ms, release a lock its holder gave up on */
+void ow_lock_periodic(void)
+{
+    if (ow_global.lock)
+        ow_global.lock--;
+}
+
 /* low-level functions */
 
 uint8_t noinline reset_onewire(uint8_t busmask)
@@ -64,14 +71,17 @@ uint8_t noinline reset_onewire(uint8_t busmask)
     /* wait 480us */
     _delay_loop_2(OW_RESET_TIMEOUT_1);
 
-    /* release bus */
-    OW_CONFIG_INPUT(busmask);
+    uint8_t data1;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        /* release bus */
+        OW_CONFIG_INPUT(busmask);
 
-    /* wait 60us (maximal pause) + 30 us (half minimum pulse) */
-    _delay_loop_2(OW_RESET_TIMEOUT_2);
+        /* wait 60us (maximal pause) + 30 us (half minimum pulse) */
+        _delay_loop_2(OW_RESET_TIMEOUT_2);
 
-    /* sample data */
-    uint8_t data1 = OW_GET_INPUT(busmask);
+        /* sample data */
+        data1 = OW_GET_INPUT(busmask);
+    }
 
     /* wait 390us */
     _delay_loop_2(OW_RESET_TIMEOUT_3);
@@ -106,9 +116,11 @@ void noinline ow_write_0(uint8_t busmask)
     /* a write 0 timeslot is initiated by holding the data line low for
      * approximately 80us */
 
-    OW_LOW(busmask);
-    _delay_loop_2(OW_WRITE_0_TIMEOUT);
-    OW_HIGH(busmask);
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        OW_LOW(busmask);
+        _delay_loop_2(OW_WRITE_0_TIMEOUT);
+        OW_HIGH(busmask);
+    }
 }
 
 uint8_t noinline ow_read(uint8_t busmask)
@@ -118,19 +130,24 @@ uint8_t noinline ow_read(uint8_t busmask)
      * wait */
     /* this is also used as ow_write_1, as the only difference
      * is that the return value is discarded */
+    /* interrupts are only disabled up to the sample point, the bus
+     * may stay idle as long as it likes between two time slots */
 
-    OW_CONFIG_OUTPUT(busmask);
-    OW_LOW(busmask);
+    uint8_t data;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        OW_CONFIG_OUTPUT(busmask);
+        OW_LOW(busmask);
 
-    _delay_loop_2(OW_READ_TIMEOUT_1);
+        _delay_loop_2(OW_READ_TIMEOUT_1);
 
-    OW_HIGH(busmask);
-    OW_CONFIG_INPUT(busmask);
+        OW_HIGH(busmask);
+        OW_CONFIG_INPUT(busmask);
 
-    _delay_loop_2(OW_READ_TIMEOUT_2);
+        _delay_loop_2(OW_READ_TIMEOUT_2);
 
-    /* sample data now */
-    uint8_t data = (uint8_t)(OW_GET_INPUT(busmask) > 0);
+        /* sample data now */
+        data = (uint8_t)(OW_GET_INPUT(busmask) > 0);
+    }
 
     /* wait for remaining slot time */
     _delay_loop_2(OW_READ_TIMEOUT_3);
@@ -508,173 +525,292 @@ int8_t ow_eeprom_read(ow_rom_code_t *rom, void *data)
 
 #endif /* ONEWIRE_DS2502_SUPPORT */
 #ifdef ONEWIRE_POLLING_SUPPORT
-ow_sensor_t ow_sensors[OW_SENSORS_COUNT] = {{{{0}},0,0,0,0,0}};
+ow_sensor_t ow_sensors[OW_SENSORS_COUNT];
 
-static int8_t ow_discover_sensor(void) {
-	uint8_t firstonbus = 1;
-	int8_t ret = 0;
-#if ONEWIRE_BUSCOUNT > 1
-	ow_global.bus = 0;
-#endif /* ONEWIRE_BUSCOUNT */
-#ifdef DEBUG_OW_POLLING
-	debug_printf("starting discovery\n");
-#endif /* DEBUG_OW_POLLING */
-	/*Prepare existing sensors*/
-	for (uint8_t i = 0; i < OW_SENSORS_COUNT; i++)
-		ow_sensors[i].present = 0;
+/* The polling engine is run from the mainloop and does one small piece
+ * of bus traffic per call, so the mainloop never stalls for long:
+ *
+ * - discovery: one ow_search_rom per call
+ * - conversion: one SKIP ROM/CONVERT issued on all buses at once
+ * - reading: one byte (or bus reset) of a scratchpad read per call
+ *
+ * Interrupts are only disabled within the single time slots. */
+enum {
+	OW_POLL_IDLE,
+	OW_POLL_DISCOVER,
+	OW_POLL_CONVERT,	/* waiting for the conversion to finish */
+	OW_POLL_READ,
+};
+
+/* steps of reading one scratchpad */
+#define OW_POLL_STEP_MATCH	1
+#define OW_POLL_STEP_ROM	2
+#define OW_POLL_STEP_READ_SP	(OW_POLL_STEP_ROM + 8)
+#define OW_POLL_STEP_DATA	(OW_POLL_STEP_READ_SP + 1)
+#define OW_POLL_STEP_DONE	(OW_POLL_STEP_DATA + 9)
+
+static struct {
+	uint8_t state;
+	uint8_t discover;	/* discovery requested */
+	uint8_t convert;	/* conversion requested */
+	uint8_t wait;		/* 0.8s ticks until the conversion is done */
+	uint8_t first;		/* next search is the first on the bus */
+	uint8_t sensor;		/* sensor being read */
+	uint8_t step;
+	uint16_t discover_delay;
+	uint16_t read_delay;
+	ow_temp_scratchpad_t sp;
+} ow_poll = {
+	/*At startup we want an immediate discovery*/
+	.discover_delay = 3,
+	.read_delay = OW_READ_DELAY,
+};
 
+static uint8_t ow_sensor_busmask(ow_sensor_t *sensor)
+{
 #if ONEWIRE_BUSCOUNT > 1
-	do {
-#endif /* ONEWIRE_BUSCOUNT > 1 */
-		do {
-			ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
-#if ONEWIRE_BUSCOUNT > 1
-				ret = ow_search_rom((uint8_t)(1 << (ow_global.bus + ONEWIRE_STARTPIN)), firstonbus);
-#else /* ONEWIRE_BUSCOUNT > 1 */
-				ret = ow_search_rom(ONEWIRE_BUSMASK, firstonbus);
-#endif /* ONEWIRE_BUSCOUNT > 1 */
-			}
-
-			/* make sure only one conversion happens at a time */
-			ow_global.lock = 1;
+	return (uint8_t)(1 << (sensor->bus + ONEWIRE_STARTPIN));
+#else
+	return ONEWIRE_BUSMASK;
+#endif
+}
 
-			if (ret == 1) {
-				firstonbus = 0;
+static void ow_discover_found(void)
+{
 #ifdef DEBUG_OW_POLLING
-				debug_printf("discovered device %02x %02x %02x %02x %02x %02x %02x %02x"
+	debug_printf("discovered device %02x %02x %02x %02x %02x %02x %02x %02x"
 #if ONEWIRE_BUSCOUNT > 1
-				             " on bus %d"
+	             " on bus %d"
 #endif /* ONEWIRE_BUSCOUNT > 1 */
-				             "\n",
-				             ow_global.current_rom.bytewise[0],
-				             ow_global.current_rom.bytewise[1],
-				             ow_global.current_rom.bytewise[2],
-				             ow_global.current_rom.bytewise[3],
-				             ow_global.current_rom.bytewise[4],
-				             ow_global.current_rom.bytewise[5],
-				             ow_global.current_rom.bytewise[6],
-				             ow_global.current_rom.bytewise[7]
+	             "\n",
+	             ow_global.current_rom.bytewise[0],
+	             ow_global.current_rom.bytewise[1],
+	             ow_global.current_rom.bytewise[2],
+	             ow_global.current_rom.bytewise[3],
+	             ow_global.current_rom.bytewise[4],
+	             ow_global.current_rom.bytewise[5],
+	             ow_global.current_rom.bytewise[6],
+	             ow_global.current_rom.bytewise[7]
 #if ONEWIRE_BUSCOUNT > 1
-				             ,ow_global.bus
+	             ,ow_global.bus
 #endif /* ONEWIRE_BUSCOUNT > 1 */
-				            );
+	            );
 #endif /* DEBUG_OW_POLLING */
-				if (ow_temp_sensor(&ow_global.current_rom)) {
-					uint8_t already_in = 0;
-					/*Determine whether this sensor is already present in our list*/
-					for (uint8_t i = 0; i < OW_SENSORS_COUNT; i++) {
-						if (ow_global.current_rom.raw == ow_sensors[i].ow_rom_code.raw) {
-							ow_sensors[i].present = 1;
-							already_in = 1;
-							/*We skip everything else to retain a regular update rate*/
-							break;
-						}
-					}
-					if (already_in == 0) {
-						uint8_t i;
-						/*The sensor we found is not in our list, so we search for the first free sensor slot, e.g. the first slot where ow_rom_code is zero*/
-						for (i = 0; i < OW_SENSORS_COUNT; i++) {
-							if (ow_sensors[i].ow_rom_code.raw == 0) {
-								/* We found a free slot...storing*/
+	if (!ow_temp_sensor(&ow_global.current_rom)) {
 #ifdef DEBUG_OW_POLLING
-								debug_printf("stored new sensor in pos %d\n", i);
+		debug_printf("not a temperature sensor\n");
 #endif /* DEBUG_OW_POLLING */
-								ow_sensors[i].ow_rom_code.raw = ow_global.current_rom.raw;
-								ow_sensors[i].present = 1;
-								ow_sensors[i].read_delay = 1; /*Read temperature asap - note: we will check for eeprom later*/
-								break;
-							}
-						}
+		return;
+	}
+
+	uint8_t i, free_slot = OW_SENSORS_COUNT;
+	/*Determine whether this sensor is already present in our list*/
+	for (i = 0; i < OW_SENSORS_COUNT; i++) {
+		if (ow_global.current_rom.raw == ow_sensors[i].ow_rom_code.raw)
+			break;
+		if (ow_sensors[i].ow_rom_code.raw == 0 && free_slot == OW_SENSORS_COUNT)
+			free_slot = i;
+	}
+
+	if (i == OW_SENSORS_COUNT) {
+		if (free_slot == OW_SENSORS_COUNT) {
 #ifdef DEBUG_OW_POLLING
-						if (i == OW_SENSORS_COUNT - 1)
-							debug_printf("number of sensors exceeds list size of %d\n", OW_SENSORS_COUNT);
+			debug_printf("number of sensors exceeds list size of %d\n", OW_SENSORS_COUNT);
 #endif /* DEBUG_OW_POLLING */
-					}
+			return;
+		}
+		/*The sensor we found is not in our list, store it in the first free slot*/
+		i = free_slot;
 #ifdef DEBUG_OW_POLLING
-				} else {
-					debug_printf("not a temperature sensor\n");
+		debug_printf("stored new sensor in pos %d\n", i);
 #endif /* DEBUG_OW_POLLING */
-				}
-			}
-		} while (ret > 0);
+		ow_sensors[i].ow_rom_code.raw = ow_global.current_rom.raw;
+		/*Read temperature asap*/
+		ow_poll.convert = 1;
+	}
+
+	ow_sensors[i].present = 1;
 #if ONEWIRE_BUSCOUNT > 1
-		ow_global.bus++;
-		firstonbus = 1;
-	} while (ow_global.bus < ONEWIRE_BUSCOUNT);
+	ow_sensors[i].bus = ow_global.bus;
+#endif
+}
+
+static void ow_discover_step(void)
+{
+	int8_t ret;
+#if ONEWIRE_BUSCOUNT > 1
+	ret = ow_search_rom((uint8_t)(1 << (ow_global.bus + ONEWIRE_STARTPIN)), ow_poll.first);
+#else /* ONEWIRE_BUSCOUNT > 1 */
+	ret = ow_search_rom(ONEWIRE_BUSMASK, ow_poll.first);
 #endif /* ONEWIRE_BUSCOUNT > 1 */
-	ow_global.lock = 0;
+
+	if (ret == 1) {
+		ow_poll.first = 0;
+		ow_discover_found();
+		return;
+	}
+
+#if ONEWIRE_BUSCOUNT > 1
+	if (++ow_global.bus < ONEWIRE_BUSCOUNT) {
+		ow_poll.first = 1;
+		return;
+	}
+#endif /* ONEWIRE_BUSCOUNT > 1 */
+
 	/*We finished the discovery process. Now we delete all removed sensors*/
 	for (uint8_t i = 0; i < OW_SENSORS_COUNT; i++) {
 		/*Mark the slot as free*/
 		if (ow_sensors[i].present == 0)
 			ow_sensors[i].ow_rom_code.raw = 0;
 	}
-	return 0;
-}
-
-/*This function will be called every 800 ms*/
-void ow_periodic(void) {
-	/*At startup we want an immediate discovery*/
-	static uint16_t discover_delay = 3;
-	if (--discover_delay == 0) {
-		discover_delay = OW_DISCOVER_DELAY;
-		ow_discover_sensor();
+	ow_global.lock = 0;
+	ow_poll.state = OW_POLL_IDLE;
 #ifdef DEBUG_OW_POLLING
-		for (uint8_t i = 0, k = 0; i < OW_SENSORS_COUNT; i++) {
-			if (ow_sensors[i].ow_rom_code.raw != 0) {
-				debug_printf("sensor #%d in list is: %02x %02x %02x %02x %02x %02x %02x %02x\n",
-						++k,
-						ow_sensors[i].ow_rom_code.bytewise[0],
-						ow_sensors[i].ow_rom_code.bytewise[1],
-						ow_sensors[i].ow_rom_code.bytewise[2],
-						ow_sensors[i].ow_rom_code.bytewise[3],
-						ow_sensors[i].ow_rom_code.bytewise[4],
-						ow_sensors[i].ow_rom_code.bytewise[5],
-						ow_sensors[i].ow_rom_code.bytewise[6],
-						ow_sensors[i].ow_rom_code.bytewise[7]);
-			}
+	for (uint8_t i = 0, k = 0; i < OW_SENSORS_COUNT; i++) {
+		if (ow_sensors[i].ow_rom_code.raw != 0) {
+			debug_printf("sensor #%d in list is: %02x %02x %02x %02x %02x %02x %02x %02x\n",
+					++k,
+					ow_sensors[i].ow_rom_code.bytewise[0],
+					ow_sensors[i].ow_rom_code.bytewise[1],
+					ow_sensors[i].ow_rom_code.bytewise[2],
+					ow_sensors[i].ow_rom_code.bytewise[3],
+					ow_sensors[i].ow_rom_code.bytewise[4],
+					ow_sensors[i].ow_rom_code.bytewise[5],
+					ow_sensors[i].ow_rom_code.bytewise[6],
+					ow_sensors[i].ow_rom_code.bytewise[7]);
 		}
+	}
 #endif /* DEBUG_OW_POLLING */
+}
+
+static void ow_read_step(void)
+{
+	/*Skip empty slots*/
+	while (ow_poll.sensor < OW_SENSORS_COUNT
+	       && !ow_temp_sensor(&ow_sensors[ow_poll.sensor].ow_rom_code))
+		ow_poll.sensor++;
+
+	if (ow_poll.sensor >= OW_SENSORS_COUNT) {
+		ow_global.lock = 0;
+		ow_poll.state = OW_POLL_IDLE;
+		return;
 	}
-	for (uint8_t i = 0; i < OW_SENSORS_COUNT; i++) {
-		if (ow_temp_sensor(&ow_sensors[i].ow_rom_code)) {
-			if (ow_sensors[i].converted == 1) {
-				if (ow_sensors[i].convert_delay == 1)
-					ow_sensors[i].convert_delay = 0;
-				else {
+
+	ow_sensor_t *sensor = &ow_sensors[ow_poll.sensor];
+	uint8_t busmask = ow_sensor_busmask(sensor);
+	uint8_t step = ow_poll.step++;
+
+	if (step == 0) {
+		if (!reset_onewire(busmask))
+			goto failed;
+	} else if (step == OW_POLL_STEP_MATCH) {
+		ow_write_byte(busmask, OW_ROM_MATCH_ROM);
+	} else if (step < OW_POLL_STEP_READ_SP) {
+		ow_write_byte(busmask, sensor->ow_rom_code.bytewise[step - OW_POLL_STEP_ROM]);
+	} else if (step == OW_POLL_STEP_READ_SP) {
+		ow_write_byte(busmask, OW_FUNC_READ_SP);
+	} else {
+		ow_poll.sp.bytewise[step - OW_POLL_STEP_DATA] = ow_read_byte(busmask);
+		if (ow_poll.step < OW_POLL_STEP_DONE)
+			return;
+
+		/* check CRC (last byte) */
+		if (ow_poll.sp.crc != crc_checksum(&ow_poll.sp.bytewise, 8))
+			goto failed;
+
+		int16_t temp = ow_temp_normalize(&sensor->ow_rom_code, &ow_poll.sp);
 #ifdef DEBUG_OW_POLLING
-					debug_printf("reading temperature\n");
+		debug_printf("temperature: %d.%d\n", HI8(temp), LO8(temp) > 0 ? 5 : 0);
 #endif /* DEBUG_OW_POLLING */
-					int8_t ret;
-					ow_temp_scratchpad_t sp;
-					ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
-						ret = ow_temp_read_scratchpad(&ow_sensors[i].ow_rom_code, &sp);
-					}
-					if (ret != 1) {
+		sensor->temp = ((int8_t) HI8(temp)) * 10 + HI8(((temp & 0x00ff) * 10) + 0x80);
+		goto next;
+	}
+	return;
+
+failed:
 #ifdef DEBUG_OW_POLLING
-						debug_printf("scratchpad read failed: %d\n", ret);
+	debug_printf("scratchpad read of sensor %d failed\n", ow_poll.sensor);
 #endif /* DEBUG_OW_POLLING */
-						return;
-					}
+next:
+	ow_poll.sensor++;
+	ow_poll.step = 0;
+}
+
+/*Run one step of the polling engine, called from the mainloop*/
+void ow_poll_process(void)
+{
+	switch (ow_poll.state) {
+	case OW_POLL_IDLE:
+		/* leave the bus alone while somebody else uses it */
+		if (ow_global.lock)
+			return;
+
+		if (ow_poll.discover) {
+			ow_poll.discover = 0;
 #ifdef DEBUG_OW_POLLING
-					debug_printf("scratchpad read succeeded\n");
+			debug_printf("starting discovery\n");
 #endif /* DEBUG_OW_POLLING */
-					int16_t temp = ow_temp_normalize(&ow_sensors[i].ow_rom_code, &sp);
+			/*Prepare existing sensors*/
+			for (uint8_t i = 0; i < OW_SENSORS_COUNT; i++)
+				ow_sensors[i].present = 0;
+#if ONEWIRE_BUSCOUNT > 1
+			ow_global.bus = 0;
+#endif /* ONEWIRE_BUSCOUNT */
+			ow_poll.first = 1;
+			ow_global.lock = OW_LOCK_TIMEOUT;
+			ow_poll.state = OW_POLL_DISCOVER;
+		}
+		else if (ow_poll.convert) {
+			ow_poll.convert = 0;
 #ifdef DEBUG_OW_POLLING
-					debug_printf("temperature: %d.%d\n", HI8(temp), LO8(temp) > 0 ? 5 : 0);
+			debug_printf("starting conversion\n");
 #endif /* DEBUG_OW_POLLING */
-					ow_sensors[i].temp = ((int8_t) HI8(temp)) * 10 + HI8(((temp & 0x00ff) * 10) + 0x80);
-					debug_printf("temperature: %d.%d\n", HI8(temp), LO8(temp) > 0 ? 5 : 0);
-					ow_sensors[i].converted = 0;
-				}
-			}
-			if (--ow_sensors[i].read_delay == 0 && ow_sensors[i].converted == 0) {
-				ow_sensors[i].read_delay = OW_READ_DELAY;
-				ow_temp_start_convert_nowait(&ow_sensors[i].ow_rom_code);
-				ow_sensors[i].convert_delay = 1;
-				ow_sensors[i].converted = 1;
-			}
+			/* start conversion on all sensors on all buses at once */
+			if (ow_temp_start_convert_nowait(NULL) < 0)
+				return;
+			/* conversion takes up to 750ms, wait at least one
+			 * full 800ms period */
+			ow_poll.wait = 2;
+			ow_global.lock = OW_LOCK_TIMEOUT;
+			ow_poll.state = OW_POLL_CONVERT;
 		}
+		break;
+
+	case OW_POLL_DISCOVER:
+		ow_global.lock = OW_LOCK_TIMEOUT;
+		ow_discover_step();
+		break;
+
+	case OW_POLL_CONVERT:
+		ow_global.lock = OW_LOCK_TIMEOUT;
+		if (ow_poll.wait)
+			break;
+		ow_poll.sensor = 0;
+		ow_poll.step = 0;
+		ow_poll.state = OW_POLL_READ;
+		/* fall through */
+
+	case OW_POLL_READ:
+		ow_global.lock = OW_LOCK_TIMEOUT;
+		ow_read_step();
+		break;
+	}
+}
+
+/*This function will be called every 800 ms*/
+void ow_periodic(void)
+{
+	if (ow_poll.wait)
+		ow_poll.wait--;
+
+	if (--ow_poll.discover_delay == 0) {
+		ow_poll.discover_delay = OW_DISCOVER_DELAY;
+		ow_poll.discover = 1;
+	}
+
+	if (ow_poll.read_delay == 0 || --ow_poll.read_delay == 0) {
+		ow_poll.read_delay = OW_READ_DELAY;
+		ow_poll.convert = 1;
 	}
 }
 #endif /* ONEWIRE_POLLING_SUPPORT */
@@ -683,5 +819,7 @@ void ow_periodic(void) {
   -- Ethersex META --
   header(hardware/onewire/onewire.h)
   init(onewire_init)
+  timer(40, ow_lock_periodic())
   ifdef(`conf_ONEWIRE_POLLING',`timer(40, ow_periodic())')
+  ifdef(`conf_ONEWIRE_POLLING',`mainloop(ow_poll_process)')
 */
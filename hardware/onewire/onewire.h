@@ -180,16 +180,21 @@ typedef struct {
 	ow_rom_code_t ow_rom_code;
 	/*We just store the temperature in order to keep memory footfrint as low as possible. We store in deci degrees (DD) => 36.4° == 364*/
 	int16_t temp;
-	uint16_t read_delay;   /*time between polling the sensor*/
-	uint8_t convert_delay; /*we need to wait 800ms for the sensor to convert the temperatures*/
-	uint8_t converted; /*when this is set, we will wait convert_delay to be 0 and then read the scratchpad*/
 	uint8_t present; /*this is set during discovery - all sensors with present == 0 will be deleted after the discovery*/
+#if ONEWIRE_BUSCOUNT > 1
+	uint8_t bus; /*bus the sensor was discovered on*/
+#endif
 } ow_sensor_t;
 /* */
 
 extern ow_sensor_t ow_sensors[OW_SENSORS_COUNT];
 #endif
 
+/* a multi step bus user (polling engine, "1w list") holds the bus by
+ * setting lock to OW_LOCK_TIMEOUT and refreshing it on every step,
+ * ow_lock_periodic counts it down so an abandoned lock is released */
+#define OW_LOCK_TIMEOUT 10	/* 0.8s ticks */
+
 /* global variables */
 typedef struct {
     uint8_t lock;
@@ -207,6 +212,7 @@ extern ow_global_t ow_global;
 
 /* prototypes */
 void onewire_init(void);
+void ow_lock_periodic(void);
 
 /* low level functions */
 uint8_t reset_onewire(uint8_t busmask);
@@ -374,6 +380,7 @@ int16_t parse_cmd_onewire_convert(char *cmd, char *output, uint16_t len);
 
 /* Polling functions*/
 void ow_periodic(void);
+void ow_poll_process(void);
 
 
 #endif /* ONEWIRE_SUPPORT */
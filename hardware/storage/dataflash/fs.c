@@ -139,13 +139,18 @@ fs_status_t fs_init(void)
     /* init free pages storage:
      * buffer 2 in dataflash is used as the free pages storage, each byte
      * represents 8 pages, if a bit is set, this page is known as free, so
-     * initialilly fill buffer 2 with 0xff's */
+     * initialilly fill buffer 2 with 0xff's; free_pages[] counts the free
+     * pages of every group, so the allocator can skip full groups without
+     * touching the bitmap */
 
     uint8_t b = 0xff;
 
     for (uint16_t i = 0; i < DF_PAGESIZE; i++)
         df_buf_write(fs.chip, DF_BUF2, &b, i, 1);
 
+    for (uint8_t i = 0; i < FS_GROUPS; i++)
+        fs.free_pages[i] = FS_GROUP_PAGES;
+
     /* scan for root node, if none could be founde, create one in page 0 */
     fs_status_t ret = fs_scan(&fs);
 
@@ -206,6 +211,10 @@ fs_status_t fs_init(void)
     /* free temporarily buffer */
     free(node);
 
+    /* the root node is the page written last, continue allocating behind it
+     * instead of at page 0, so that rebooting does not wear the first pages */
+    fs.last_free = fs.root;
+
 #ifdef DEBUG_FS_MARK
     printf("fs: used pages:\r\n");
     for (uint16_t i = 0; i < DF_PAGES; i++) {
@@ -215,7 +224,7 @@ fs_status_t fs_init(void)
     }
 #endif
 
-    printf("fs: root page is 0x%04x\n", fs.root);
+    printf("fs: root page is 0x%04x, %u pages free\n", fs.root, fs_free(&fs));
 
     return FS_OK;
 
@@ -285,7 +294,7 @@ fs_inode_t fs_get_inode(fs_t *fs, const char *file)
 
 }
 
-fs_size_t fs_read(fs_t *fs, fs_inode_t inode, void *buf, fs_size_t offset, fs_size_t length)
+fs_size_t fs_read(fs_t *fs, fs_inode_t inode, fs_cursor_t *cursor, void *buf, fs_size_t offset, fs_size_t length)
 {
 
     uint8_t *b = (uint8_t *)buf;
@@ -293,9 +302,22 @@ fs_size_t fs_read(fs_t *fs, fs_inode_t inode, void *buf, fs_size_t offset, fs_si
     assert(length > 0);
 
     fs_size_t read = 0;
+    df_page_t pagenum;
+
+    /* file offset of the first data byte in pagenum */
+    fs_size_t base = 0;
 
-    /* load first page address */
-    df_page_t pagenum = fs_page(fs, inode);
+    /* continue at the page the last read stopped in, if the filesystem did
+     * not change since (pages are moved on every write) and the requested
+     * offset is not before this page, else start at the first page */
+    if (cursor != NULL && cursor->version == fs->version
+            && cursor->base <= offset) {
+        pagenum = cursor->page;
+        base = cursor->base;
+    } else
+        pagenum = fs_page(fs, inode);
+
+    offset -= base;
 
     printf("reading inode %d (starting at page %d): %d bytes starting at %d\n", inode, pagenum, length, offset);
 
@@ -325,11 +347,19 @@ fs_size_t fs_read(fs_t *fs, fs_inode_t inode, void *buf, fs_size_t offset, fs_si
 
         printf("\tnext page is at %d\n", pagenum);
         offset -= FS_DATASIZE;
+        base += FS_DATASIZE;
 
     }
 
     printf("remaining offset is %d\n", offset);
 
+    /* remember the page the data starts in */
+    if (cursor != NULL) {
+        cursor->version = fs->version;
+        cursor->page = pagenum;
+        cursor->base = base;
+    }
+
     /* load page data */
     df_flash_read(fs->chip, pagenum, &page, FS_STRUCTURE_OFFSET, sizeof(fs_page_t));
 
@@ -351,7 +381,7 @@ fs_size_t fs_read(fs_t *fs, fs_inode_t inode, void *buf, fs_size_t offset, fs_si
         if (length+offset <= page.size) {
 
             printf("\tlast page (but not eof), length %d, offset %d\n", length, offset);
-            df_flash_read(fs->chip, pagenum, b, FS_DATA_OFFSET+offset, length+offset);
+            df_flash_read(fs->chip, pagenum, b, FS_DATA_OFFSET+offset, length);
             read += length;
             return read;
 
@@ -382,6 +412,13 @@ fs_size_t fs_read(fs_t *fs, fs_inode_t inode, void *buf, fs_size_t offset, fs_si
         length -= read_bytes;
         b += read_bytes;
         offset = 0;
+        base += page.size;
+
+        /* the next read most likely continues in this page */
+        if (cursor != NULL) {
+            cursor->page = pagenum;
+            cursor->base = base;
+        }
 
     }
 
@@ -423,6 +460,8 @@ fs_status_t fs_write(fs_t *fs, fs_inode_t inode, void *buf, fs_size_t offset, fs
         uint8_t eof = 0;
 
         do {
+            df_page_t obsolete = 0xffff;
+
             printf("\tlength > 0 (%ld), old page is %d\n",
 		   length, old_pagenum);
 
@@ -455,9 +494,12 @@ fs_status_t fs_write(fs_t *fs, fs_inode_t inode, void *buf, fs_size_t offset, fs
                     eof = 1;
                 }
 
-                if (!page.eof)
-                    /* save old pagenum */
+                if (!page.eof) {
+                    /* the old page has been copied to BUF1, it is freed
+                     * after the new one is written; save old pagenum */
+                    obsolete = old_pagenum;
                     old_pagenum = fs_page(fs, page.next_inode);
+                }
 
                 page.unused = 0;
                 page.eof = 0;
@@ -492,9 +534,10 @@ fs_status_t fs_write(fs_t *fs, fs_inode_t inode, void *buf, fs_size_t offset, fs
 		       "offset 0x%04lx, eof %d, old page 0x%04x\n",
 		       length, offset, eof, old_pagenum);
 
-                /* load old page into buffer */
+                /* load old page into buffer, it is obsolete afterwards */
                 df_buf_load(fs->chip, DF_BUF1, old_pagenum);
                 df_wait(fs->chip);
+                obsolete = old_pagenum;
 
                 /* load structure */
                 df_buf_read(fs->chip, DF_BUF1, &page, FS_STRUCTURE_OFFSET, sizeof(fs_page_t));
@@ -527,6 +570,11 @@ fs_status_t fs_write(fs_t *fs, fs_inode_t inode, void *buf, fs_size_t offset, fs
 
             }
 
+            /* the new root node no longer references the old page and its
+             * replacement is on the flash, only now it may be reused */
+            if (obsolete != 0xffff)
+                fs_mark_free(fs, obsolete);
+
             offset = 0;
         } while (length > 0);
 
@@ -706,6 +754,9 @@ fs_status_t noinline fs_truncate(fs_t *fs, fs_inode_t inode, fs_size_t length)
 	df_buf_save (fs->chip, DF_BUF1, new_pagenum);
 	df_wait (fs->chip);
 
+	/* The old page has been replaced, it may be reused now. */
+	fs_mark_free (fs, pagenum);
+
     } while (0); /* (found_eof == 0); FIXME */
 
 
@@ -902,8 +953,42 @@ fs_status_t fs_remove(fs_t *fs, char *name)
     if (ret != FS_OK)
         return ret;
 
+    /* the new root node no longer references this file, free the pages
+     * following the first one, the first one is freed after its inode */
+    df_page_t first = fs_page(fs, inode);
+    df_page_t pagenum = first;
+
+    while (pagenum != 0xffff) {
+        fs_page_t page;
+        df_flash_read(fs->chip, pagenum, &page, FS_STRUCTURE_OFFSET, sizeof(fs_page_t));
+
+        if (page.eof)
+            break;
+
+        pagenum = fs_page(fs, page.next_inode);
+        if (pagenum != 0xffff)
+            fs_mark_free(fs, pagenum);
+    }
+
     /* remove inode */
-    return fs_update_inodetable(fs, inode, 0xffff);
+    ret = fs_update_inodetable(fs, inode, 0xffff);
+
+    if (ret == FS_OK && first != 0xffff)
+        fs_mark_free(fs, first);
+
+    return ret;
+
+}
+
+uint16_t fs_free(fs_t *fs)
+{
+
+    uint16_t pages = 0;
+
+    for (uint8_t i = 0; i < FS_GROUPS; i++)
+        pages += fs->free_pages[i];
+
+    return pages;
 
 }
 
@@ -1116,23 +1201,58 @@ df_page_t fs_new_page(fs_t *fs)
 {
 
     df_page_t page = (fs->last_free + 1) % DF_PAGES;
+    uint16_t left = DF_PAGES;
 
-    /* sequentially check pages, until a free one can be found */
-    while (fs_used(fs, page) && page != fs->last_free)
-        page = (page + 1) % DF_PAGES;
+    /* hand out the pages round robin, starting behind the last allocated
+     * one, so that every free page is written once before any page is
+     * written again (wear-levelling) */
+    while (left > 0) {
 
-    // printf("last free page %d, new free page %d\n", fs->last_free, page);
+        /* skip groups without free pages, using the counters in RAM */
+        if (fs->free_pages[page / FS_GROUP_PAGES] == 0) {
+            uint8_t skip = FS_GROUP_PAGES - page % FS_GROUP_PAGES;
 
-    if (page == fs->last_free)
-        /* no free page could be found */
-        return 0xffff;
-    else {
-        /* free page is found */
-        fs->last_free = page;
+            if (skip >= left)
+                break;
+
+            left -= skip;
+            page = (page + skip) % DF_PAGES;
+            continue;
+        }
+
+        /* else check the remaining pages of this bitmap byte at once */
+        uint8_t b;
+        df_buf_read(fs->chip, DF_BUF2, &b, page/8, 1);
+        b >>= page % 8;
+
+        while (b && !(b & 1)) {
+            b >>= 1;
+            page++;
+            left--;
+        }
+
+        if (b && left > 0) {
+            /* free page is found */
+            // printf("last free page %d, new free page %d\n", fs->last_free, page);
+            fs->last_free = page;
+            fs_mark_used(fs, page);
+
+            return page;
+        }
+
+        uint8_t skip = 8 - page % 8;
+
+        if (skip >= left)
+            break;
+
+        left -= skip;
+        page = (page + skip) % DF_PAGES;
 
-        return page;
     }
 
+    /* no free page could be found */
+    return 0xffff;
+
 }
 
 fs_inode_t fs_new_inode(fs_t *fs)
@@ -1216,11 +1336,18 @@ void fs_mark(fs_t *fs, df_page_t page, uint8_t is_free)
     printf("fs: read byte at offset 0x%04x: 0x%02x\r\n", page/8, b);
 #endif
 
-    /* set bit and write byte */
-    if (is_free)
+    /* nothing to do, if the page already is in this state */
+    if (!(b & _BV(page % 8)) == !is_free)
+        return;
+
+    /* set bit, update group counter and write byte */
+    if (is_free) {
         b |= _BV(page % 8);
-    else
+        fs->free_pages[page / FS_GROUP_PAGES]++;
+    } else {
         b &= ~_BV(page % 8);
+        fs->free_pages[page / FS_GROUP_PAGES]--;
+    }
 
     df_buf_write(fs->chip, DF_BUF2, &b, page/8, 1);
 
@@ -1288,6 +1415,8 @@ fs_status_t fs_increment(fs_t *fs)
     df_buf_save(fs->chip, DF_BUF1, page);
     df_wait(fs->chip);
 
+    /* the old root node is obsolete now */
+    fs_mark_free(fs, fs->root);
     fs->root = page;
 
     free(root);
@@ -1300,6 +1429,11 @@ fs_status_t fs_update_inodetable(fs_t *fs, fs_inode_t inode, df_page_t page)
 
     // printf("updating inodetable %d -> %d\n", inode, page);
 
+    /* remember the inodetable page which becomes obsolete by this update,
+     * the data page formerly referenced by this inode is freed by the
+     * caller, after it has been copied */
+    df_page_t old_table = fs_inodetable(fs, inode / FS_INODES_PER_TABLE);
+
     /* allocate new page for the inodetable */
     df_page_t new_page = fs_new_page(fs);
 
@@ -1325,7 +1459,7 @@ fs_status_t fs_update_inodetable(fs_t *fs, fs_inode_t inode, df_page_t page)
     // printf("inode index %d\n", inode % FS_INODES_PER_TABLE);
 
     /* load inodetable into BUF1, update inode, write inodetable */
-    df_buf_load(fs->chip, DF_BUF1, fs_inodetable(fs, inode / FS_INODES_PER_TABLE));
+    df_buf_load(fs->chip, DF_BUF1, old_table);
     df_wait(fs->chip);
     df_buf_write(fs->chip,
                  DF_BUF1,
@@ -1349,7 +1483,15 @@ fs_status_t fs_update_inodetable(fs_t *fs, fs_inode_t inode, df_page_t page)
                  sizeof(df_page_t));
 
     /* increment version and update checksum */
-    return fs_increment(fs);
+    fs_status_t ret = fs_increment(fs);
+
+    if (ret != FS_OK)
+        return ret;
+
+    /* free the old inodetable not until the new root node is written */
+    fs_mark_free(fs, old_table);
+
+    return FS_OK;
 
 }
 
@@ -44,6 +44,11 @@
 
 #define FS_FILENAME 6
 
+/* the free page bitmap (in BUF2) is summarized in RAM by groups of
+ * FS_GROUP_PAGES pages, each holding the number of free pages in it */
+#define FS_GROUP_PAGES 64
+#define FS_GROUPS (DF_PAGES/FS_GROUP_PAGES)
+
 #define noinline __attribute__((noinline))
 
 /* structs */
@@ -69,8 +74,17 @@ typedef struct {
     df_page_t root;
     fs_version_t version;
     df_page_t last_free;
+    uint8_t free_pages[FS_GROUPS];
 } fs_t;
 
+/* position of a read, to continue reading without following the page
+ * chain from the start of the file, only valid as long as version matches */
+typedef struct {
+    fs_version_t version;
+    df_page_t page;
+    fs_size_t base; /* file offset of the first byte in page */
+} fs_cursor_t;
+
 /* prototypes */
 
 /* initialize filesystem, scan dataflash, format if no filesystem is found */
@@ -78,12 +92,13 @@ fs_status_t noinline fs_init(void);
 /* list files in directory, write filename to buffer, return FS_OK or FS_EOF if no more */
 fs_status_t noinline fs_list(fs_t *fs, char *dir, char *buf, fs_index_t index);
 fs_inode_t noinline fs_get_inode(fs_t *fs, const char *file);
-fs_size_t noinline fs_read(fs_t *fs, fs_inode_t inode, void *buf, fs_size_t offset, fs_size_t length);
+fs_size_t noinline fs_read(fs_t *fs, fs_inode_t inode, fs_cursor_t *cursor, void *buf, fs_size_t offset, fs_size_t length);
 fs_status_t noinline fs_write(fs_t *fs, fs_inode_t inode, void *buf, fs_size_t offset, fs_size_t length);
 fs_status_t noinline fs_truncate(fs_t *fs, fs_inode_t inode, fs_size_t length);
 fs_status_t noinline fs_create(fs_t *fs, const char *name);
 fs_status_t noinline fs_remove(fs_t *fs, char *name);
 fs_size_t noinline fs_size(fs_t *fs, fs_inode_t inode);
+uint16_t noinline fs_free(fs_t *fs);
 
 /* local */
 fs_status_t noinline fs_scan(fs_t *fs); /* scan for the root node */
@@ -92,7 +107,7 @@ df_page_t noinline fs_new_page(fs_t *fs); /* return an empty (=unused) page or 0
 fs_inode_t noinline fs_new_inode(fs_t *fs); /* return an empty (=unused) inode or 0xffff if none could be found */
 df_page_t noinline fs_inodetable(fs_t *fs, uint8_t tableid); /* return the page this inodetable lives in */
 df_page_t noinline fs_page(fs_t *fs, fs_inode_t inode); /* get the page this inode points to */
-void noinline fs_mark(fs_t *fs, df_page_t page, uint8_t free); /* mark page as used or free (cache in BUF2) */
+void noinline fs_mark(fs_t *fs, df_page_t page, uint8_t free); /* mark page as used or free (cache in BUF2, count in free_pages[]) */
 #define fs_mark_free(fs, page) fs_mark(fs, page, 1)
 #define fs_mark_used(fs, page) fs_mark(fs, page, 0)
 uint8_t noinline fs_used(fs_t *fs, df_page_t page); /* check if this page is used */
@@ -32,12 +32,15 @@ vfs_df_open (const char *filename)
     return NULL;		/* No such file. */
 
   struct vfs_file_handle_t *fh = malloc (sizeof (struct vfs_file_handle_t));
-  if (fh == NULL)
+  if (fh == NULL) {
+    vfs_open_error ();
     return NULL;
+  }
 
   fh->fh_type = VFS_DF;
   fh->u.df.inode = i;
   fh->u.df.offset = 0;
+  fh->u.df.cursor.version = 0;	/* Never matches a valid fs version. */
 
   return fh;
 }
@@ -51,7 +54,8 @@ vfs_df_close (struct vfs_file_handle_t *fh)
 vfs_size_t
 vfs_df_read (struct vfs_file_handle_t *fh, void *buf, vfs_size_t length)
 {
-  vfs_size_t ret = fs_read (&fs, fh->u.df.inode, buf, fh->u.df.offset, length);
+  vfs_size_t ret = fs_read (&fs, fh->u.df.inode, &fh->u.df.cursor, buf,
+			    fh->u.df.offset, length);
 
   /* Read was successful, update offset. */
   if (ret > 0) fh->u.df.offset += ret;
@@ -135,3 +139,10 @@ vfs_df_size (struct vfs_file_handle_t *fh)
 {
   return fs_size (&fs, fh->u.df.inode);
 }
+
+uint32_t
+vfs_df_etag (struct vfs_file_handle_t *fh)
+{
+  /* The filesystem version is incremented on every write. */
+  return fs.version ^ ((uint32_t) fh->u.df.inode << 24);
+}
@@ -29,6 +29,9 @@ typedef struct {
   fs_inode_t inode;
   fs_size_t offset;
 
+  /* Page the last read stopped in, so sequential reads don't have to
+     follow the page chain from the start of the file. */
+  fs_cursor_t cursor;
 } vfs_file_handle_df_t;
 
 /* vfs_df_ Prototypes. */
@@ -43,6 +46,7 @@ uint8_t vfs_df_fseek (struct vfs_file_handle_t *, vfs_size_t offset,
 uint8_t vfs_df_truncate (struct vfs_file_handle_t *, vfs_size_t length);
 struct vfs_file_handle_t *vfs_df_create (const char *name);
 vfs_size_t vfs_df_size (struct vfs_file_handle_t *);
+uint32_t vfs_df_etag (struct vfs_file_handle_t *);
 
 
 #define VFS_DF_FUNCS {				\
@@ -55,6 +59,7 @@ vfs_size_t vfs_df_size (struct vfs_file_handle_t *);
     vfs_df_truncate,				\
     vfs_df_create,				\
     vfs_df_size,				\
+    vfs_df_etag,				\
   }
 
 #endif	/* VFS_DF_H */
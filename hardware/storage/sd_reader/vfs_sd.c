@@ -59,6 +59,9 @@ vfs_sd_try_open_rootnode (void)
   }
 
   SDDEBUG ("SD-Card initialized and root node opened.\n");
+#ifdef VFS_NEGCACHE_SUPPORT
+  vfs_negcache_flush ();	/* Files on the card weren't there before. */
+#endif
   return 0;			/* Jippie, we're set. */
 }
 
@@ -78,8 +81,10 @@ vfs_sd_open_in (struct fat_dir_struct *parent, const char *filename)
     /* Got it :) */
     struct fat_file_struct *inode = fat_open_file (vfs_sd_fat, &filep);
     struct vfs_file_handle_t *fh = malloc (sizeof (struct vfs_file_handle_t));
-    if (fh == NULL)
+    if (fh == NULL) {
+      vfs_open_error ();
       return NULL;
+    }
 
     fh->fh_type = VFS_SD;
     fh->u.sd = inode;
@@ -259,6 +264,19 @@ vfs_sd_size (struct vfs_file_handle_t *fh)
   return fh->u.sd->dir_entry.file_size;
 }
 
+uint32_t
+vfs_sd_etag (struct vfs_file_handle_t *fh)
+{
+  struct fat_dir_entry_struct *de = &fh->u.sd->dir_entry;
+#if FAT_DATETIME_SUPPORT
+  return (((uint32_t) de->modification_date << 16)
+	  | de->modification_time) ^ de->file_size;
+#else
+  /* Without timestamps only appending or relocating is detected. */
+  return ((uint32_t) de->cluster << 16) ^ de->file_size;
+#endif
+}
+
 #ifdef SD_PING_READ
 uint8_t
 vfs_sd_ping (void)
@@ -290,6 +290,25 @@ pin(STELLA_PIN, format(`P%s%d', pinname, itr))
 #define STELLA_DDR_PORT2 format(DDR%s, pinname)
 ')
 
+define(`STELLA_PORT3_RANGE', `dnl
+define(`pinname', translit(substr(`$1', 1, 1), `a-z', `A-Z'))dnl
+define(`start', substr(`$1', 2, 1))dnl
+define(`stop', substr(`$2', 2, 1))dnl
+  /* stella port range configuration: */
+  forloop(`itr', start, stop, `dnl
+#undef STELLA_PIN_PORT
+#undef STELLA_PIN_PIN
+#undef HAVE_STELLA_PIN  /* quite a hack, but should do the job *g*    \
+                           this is just to keep the preprocessor from \
+			   complaining and get the port masks right. */
+pin(STELLA_PIN, format(`P%s%d', pinname, itr))
+  ' )dnl
+#define STELLA_PINS_PORT3 eval(stop-start+1)
+#define STELLA_OFFSET_PORT3 start
+#define STELLA_PORT3 format(PORT%s, pinname)
+#define STELLA_DDR_PORT3 format(DDR%s, pinname)
+')
+
 define(`PCA9685_OE', `dnl
 define(`pinname', translit(substr(`$1',1,1), `a-z',`A-Z'))dnl
 #define PCA9685_OE_PIN $1
@@ -72,9 +72,40 @@ int16_t parse_cmd_nslookup (char *cmd, char *output, uint16_t len)
   }
 }
 
+int16_t parse_cmd_dns_cache (char *cmd, char *output, uint16_t len)
+{
+  const char *name;
+  uip_ipaddr_t *addr;
+  uint16_t ttl;
+  int16_t n;
+
+  if (cmd[0] != 0x05) {
+    cmd[0] = 0x05;  //magic byte
+    cmd[1] = 0x00;
+
+    return ECMD_AGAIN(snprintf_P(output, len, PSTR("hit %u miss %u query %u"),
+                                 resolv_stats.hit, resolv_stats.miss,
+                                 resolv_stats.query));
+  }
+
+  do {
+    if (! resolv_entry (cmd[1]++, &name, &ttl, &addr))
+      return ECMD_FINAL_OK;
+  } while (name == NULL);
+
+  n = snprintf_P(output, len, PSTR("%s %u "), name, ttl);
+  if (addr)
+    n += print_ipaddr(addr, output + n, len - n);
+  else
+    n += snprintf_P(output + n, len - n, ttl ? PSTR("nxdomain") : PSTR("pending"));
+
+  return ECMD_AGAIN(n);
+}
+
 /*
   -- Ethersex META --
   block(DNS Resolver)
   ecmd_feature(nslookup, "nslookup ", HOSTNAME, Do DNS lookup for HOSTNAME (call twice).)
+  ecmd_feature(dns_cache, "dns cache",, Display the DNS cache (name, TTL, address) and hit/miss counters.)
   ecmd_feature(dns_server, "dns server", [IPADDR], Display/Set the IP address of the DNS server to use to IPADDR.)
 */
@@ -112,6 +112,16 @@ struct dns_answer {
   uip_ipaddr_t ipaddr;
 };
 
+/** \internal The number of callbacks a single query can notify. */
+#define RESOLV_CALLBACKS 2
+
+/** \internal The maximum TTL of a cache entry, in seconds. */
+#define MAX_TTL 0xFFFF
+
+/** \internal Error of an entry holding the truncated name of a
+    resolv_query() for a name that doesn't fit into an entry. */
+#define ERR_TOOLONG 0xFF
+
 struct namemap {
 #define STATE_UNUSED 0
 #define STATE_NEW    1
@@ -121,20 +131,24 @@ struct namemap {
   u8_t state;
   u8_t tmr;
   u8_t retries;
-  u8_t seqno;
   u8_t err;
+  u16_t age;
+  u16_t ttl;
   char name[32];
   uip_ipaddr_t ipaddr;
-  resolv_found_callback_t callback;
+  resolv_found_callback_t callback[RESOLV_CALLBACKS];
 };
 
-#ifndef UIP_CONF_RESOLV_ENTRIES
+#if defined(DNS_CACHE_ENTRIES)
+#define RESOLV_ENTRIES DNS_CACHE_ENTRIES
+#elif !defined(UIP_CONF_RESOLV_ENTRIES)
 #define RESOLV_ENTRIES 4
 #else /* UIP_CONF_RESOLV_ENTRIES */
 #define RESOLV_ENTRIES UIP_CONF_RESOLV_ENTRIES
 #endif /* UIP_CONF_RESOLV_ENTRIES */
 
 #define DNS_RECORD_TYPE_A    0x01
+#define DNS_RECORD_TYPE_CNAME 0x05
 #define DNS_RECORD_TYPE_AAAA 0x1c
 
 #if UIP_CONF_IPV6
@@ -149,7 +163,7 @@ struct namemap {
 
 static struct namemap names[RESOLV_ENTRIES];
 
-static u8_t seqno;
+struct resolv_stats resolv_stats;
 
 static uip_udp_conn_t *resolv_conn = NULL;
 
@@ -184,6 +198,56 @@ parse_name(unsigned char *query)
   return query + 1;
 }
 /*---------------------------------------------------------------------------*/
+/** \internal
+ * Pass the result of an entry to all callbacks waiting for it.
+ */
+/*---------------------------------------------------------------------------*/
+static void
+resolv_found(struct namemap *namemapptr)
+{
+  u8_t i;
+  uip_ipaddr_t *ipaddr = NULL;
+  resolv_found_callback_t callback;
+
+  if(namemapptr->state == STATE_DONE)
+    ipaddr = &namemapptr->ipaddr;
+
+  for(i = 0; i < RESOLV_CALLBACKS; ++i) {
+    callback = namemapptr->callback[i];
+    namemapptr->callback[i] = NULL;
+    if(callback)
+      callback(namemapptr->name, ipaddr);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/** \internal
+ * Check whether callbacks are queued for an entry.  They are queued
+ * from the first slot on, so checking it is sufficient.  Such an entry
+ * must not be recycled before resolv_found() has been called.
+ */
+/*---------------------------------------------------------------------------*/
+static u8_t
+resolv_waiting(struct namemap *namemapptr)
+{
+  return namemapptr->callback[0] != NULL;
+}
+/*---------------------------------------------------------------------------*/
+/** \internal
+ * Find the entry of a name, regardless of its state.
+ */
+/*---------------------------------------------------------------------------*/
+static struct namemap *
+resolv_find(const char *name)
+{
+  u8_t i;
+
+  for(i = 0; i < RESOLV_ENTRIES; ++i)
+    if(names[i].state != STATE_UNUSED && names[i].err != ERR_TOOLONG &&
+       strcmp(name, names[i].name) == 0)
+      return &names[i];
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
 /** \internal
  * Runs through the list of names to see if there are any that have
  * not yet been queried and, if so, sends out a query.
@@ -198,6 +262,17 @@ resolv_periodic(void)
   static u8_t n;
   register struct namemap *namemapptr;
 
+  /* Answer queries for names that were already in the cache. */
+  for(i = 0; i < RESOLV_ENTRIES; ++i) {
+    namemapptr = &names[i];
+    if(namemapptr->state == STATE_DONE ||
+       namemapptr->state == STATE_ERROR) {
+      resolv_found(namemapptr);
+      if(namemapptr->err == ERR_TOOLONG)
+	namemapptr->state = STATE_UNUSED;
+    }
+  }
+
   for(i = 0; i < RESOLV_ENTRIES; ++i) {
     namemapptr = &names[i];
     if(namemapptr->state == STATE_NEW ||
@@ -205,9 +280,11 @@ resolv_periodic(void)
       if(namemapptr->state == STATE_ASKING) {
 	if(--namemapptr->tmr == 0) {
 	  if(++namemapptr->retries == MAX_RETRIES) {
+	    /* Don't hammer an unreachable server, cache the failure
+	       just like a non-existent name. */
 	    namemapptr->state = STATE_ERROR;
-            if (namemapptr->callback)
-              namemapptr->callback(namemapptr->name, NULL);
+	    namemapptr->ttl = DNS_NEGATIVE_TTL;
+	    resolv_found(namemapptr);
 	    continue;
 	  }
 	  namemapptr->tmr = namemapptr->retries;
@@ -267,6 +344,7 @@ resolv_newdata(void)
   static u8_t /*nquestions,*/ nanswers;
   static u8_t i;
   register struct namemap *namemapptr;
+  uint32_t ttl, minttl = MAX_TTL;
 
   hdr = (struct dns_hdr *)uip_appdata;
   /*  printf("ID %d\n", htons(hdr->id));
@@ -293,8 +371,8 @@ resolv_newdata(void)
     /* Check for error. If so, call callback to inform. */
     if(namemapptr->err != 0 || hdr->numanswers == 0) {
       namemapptr->state = STATE_ERROR;
-      if (namemapptr->callback)
-        namemapptr->callback(namemapptr->name, NULL);
+      namemapptr->ttl = DNS_NEGATIVE_TTL;
+      resolv_found(namemapptr);
       return;
     }
 
@@ -321,6 +399,11 @@ resolv_newdata(void)
       }
 
       ans = (struct dns_answer *)nameptr;
+      /* The lifetime of the result is bounded by all records of the
+	 chain, i.e. CNAMEs as well. */
+      ttl = ((uint32_t) htons(ans->ttl[0]) << 16) | htons(ans->ttl[1]);
+      if(ttl < minttl)
+	minttl = ttl;
       /*      printf("Answer: type %x, class %x, ttl %x, length %x\n",
 	     htons(ans->type), htons(ans->class), (htons(ans->ttl[0])
 	     << 16) | htons(ans->ttl[1]), htons(ans->len));*/
@@ -346,14 +429,20 @@ resolv_newdata(void)
 	namemapptr->ipaddr[1] = ans->ipaddr[1];
 #endif /* !UIP_CONF_IPV6 */
 
-        if (namemapptr->callback)
-          namemapptr->callback(namemapptr->name, (uip_ipaddr_t *)namemapptr->ipaddr);
+	namemapptr->ttl = minttl ? minttl : 1;
+	resolv_found(namemapptr);
 	return;
       } else {
 	nameptr = nameptr + 10 + htons(ans->len);
       }
       --nanswers;
     }
+
+    /* No address record, e.g. only a CNAME or an AAAA record in an
+       IPv4 build. */
+    namemapptr->state = STATE_ERROR;
+    namemapptr->ttl = DNS_NEGATIVE_TTL;
+    resolv_found(namemapptr);
   }
 
 }
@@ -363,40 +452,97 @@ resolv_newdata(void)
  * Queues a name so that a question for the name will be sent out.
  *
  * \param name The hostname that is to be queried.
+ * \param callback Called with the result on a later poll of the
+ * resolver, may be NULL.  Names too long for the cache are reported
+ * as not found, with the name truncated.
+ *
+ * \return Zero if the query was refused, because RESOLV_CALLBACKS
+ * other callbacks are already waiting for the name or callbacks are
+ * waiting for all entries of the cache.
  */
 /*---------------------------------------------------------------------------*/
-void
+u8_t
 resolv_query(const char *name, resolv_found_callback_t callback)
 {
   static u8_t i;
-  static u8_t lseq, lseqi;
-  register struct namemap *nameptr = NULL;
-
-  lseq = lseqi = 0;
-
-  for(i = 0; i < RESOLV_ENTRIES; ++i) {
-    nameptr = &names[i];
-    if(nameptr->state == STATE_UNUSED) {
-      break;
+  static u8_t lrui;
+  static u8_t lrurank;
+  u8_t rank;
+  register struct namemap *nameptr;
+
+  /* If the name is cached or a query for it is already running, just
+     queue the callback.  Cached results are passed on with the next
+     poll of the resolver. */
+  nameptr = resolv_find(name);
+  if(nameptr == NULL) {
+    u8_t toolong = strlen(name) >= sizeof(nameptr->name);
+
+    if(toolong && callback == NULL)
+      return 1;
+
+    /* Take an unused entry, else evict the least recently used one,
+       preferring entries which are not waiting for an answer.  Entries
+       with queued callbacks are never evicted. */
+    lrui = lrurank = 0;
+
+    for(i = 0; i < RESOLV_ENTRIES; ++i) {
+      nameptr = &names[i];
+      if(nameptr->state == STATE_UNUSED) {
+	break;
+      }
+      if(resolv_waiting(nameptr))
+	continue;
+      rank = (nameptr->state == STATE_DONE ||
+	      nameptr->state == STATE_ERROR) ? 2 : 1;
+      if(rank > lrurank ||
+	 (rank == lrurank && nameptr->age >= names[lrui].age)) {
+	lrurank = rank;
+	lrui = i;
+      }
     }
-    if(seqno - nameptr->seqno > lseq) {
-      lseq = seqno - nameptr->seqno;
-      lseqi = i;
+
+    if(i == RESOLV_ENTRIES) {
+      if(lrurank == 0) {
+	debug_printf("resolv: no free entry for %s\n", name);
+	return 0;
+      }
+      i = lrui;
+      nameptr = &names[i];
     }
-  }
 
-  if(i == RESOLV_ENTRIES) {
-    i = lseqi;
-    nameptr = &names[i];
+    /*  printf("Using entry %d\n", i);*/
+
+    memset(nameptr->callback, 0, sizeof(nameptr->callback));
+
+    if(toolong) {
+      /* Can't be asked for, report the error with the next poll like
+	 any other failure.  The entry is released afterwards. */
+      strncpy(nameptr->name, name, sizeof(nameptr->name) - 1);
+      nameptr->name[sizeof(nameptr->name) - 1] = 0;
+      nameptr->state = STATE_ERROR;
+      nameptr->err = ERR_TOOLONG;
+      nameptr->ttl = MAX_TTL;
+    } else {
+      strcpy(nameptr->name, name);
+      nameptr->state = STATE_NEW;
+      nameptr->err = 0;
+      resolv_stats.query++;
+    }
   }
 
-  /*  printf("Using entry %d\n", i);*/
+  nameptr->age = 0;
 
-  strcpy(nameptr->name, name);
-  nameptr->state = STATE_NEW;
-  nameptr->seqno = seqno;
-  nameptr->callback = callback;
-  ++seqno;
+  if(callback) {
+    for(i = 0; i < RESOLV_CALLBACKS; ++i)
+      if(nameptr->callback[i] == NULL || nameptr->callback[i] == callback)
+	break;
+    if(i == RESOLV_CALLBACKS) {
+      debug_printf("resolv: too many callbacks for %s\n", nameptr->name);
+      return 0;
+    }
+    nameptr->callback[i] = callback;
+  }
+  return 1;
 }
 /*---------------------------------------------------------------------------*/
 /**
@@ -424,12 +570,67 @@ resolv_lookup(const char *name)
     nameptr = &names[i];
     if(nameptr->state == STATE_DONE &&
        strcmp(name, nameptr->name) == 0) {
+      nameptr->age = 0;
+      resolv_stats.hit++;
       return (uip_ipaddr_t *)nameptr->ipaddr;
     }
   }
+  resolv_stats.miss++;
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
+/**
+ * Age the cache entries, to be called once a second.
+ *
+ * Expires entries whose TTL has run out and counts the seconds since
+ * each entry was used last, saturating, for the LRU eviction.
+ */
+/*---------------------------------------------------------------------------*/
+void
+resolv_tick(void)
+{
+  u8_t i;
+
+  for(i = 0; i < RESOLV_ENTRIES; ++i) {
+    if(names[i].age != 0xFFFF)
+      names[i].age++;
+    /* Keep expired entries until their callbacks have been called
+       with the next poll. */
+    if((names[i].state == STATE_DONE || names[i].state == STATE_ERROR)
+       && !resolv_waiting(&names[i])
+       && (names[i].ttl == 0 || --names[i].ttl == 0))
+      names[i].state = STATE_UNUSED;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Get an entry of the cache.
+ *
+ * \param i Index of the entry.
+ * \param name Set to the name of the entry or NULL, if it's unused.
+ * \param ttl Remaining lifetime of the entry in seconds, zero while
+ * the query is still running.
+ * \param ipaddr Set to the address of the name or NULL, if the name
+ * isn't resolved (yet).
+ *
+ * \return Zero if I is beyond the last entry.
+ */
+/*---------------------------------------------------------------------------*/
+u8_t
+resolv_entry(u8_t i, const char **name, u16_t *ttl, uip_ipaddr_t **ipaddr)
+{
+  struct namemap *nameptr;
+
+  if(i >= RESOLV_ENTRIES)
+    return 0;
+
+  nameptr = &names[i];
+  *name = nameptr->state == STATE_UNUSED ? NULL : nameptr->name;
+  *ipaddr = nameptr->state == STATE_DONE ? &nameptr->ipaddr : NULL;
+  *ttl = nameptr->state >= STATE_DONE ? nameptr->ttl : 0;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
 /**
  * Obtain the currently configured DNS server.
  *
@@ -457,11 +658,24 @@ resolv_getserver(void)
 void
 resolv_conf(uip_ipaddr_t *dnsserver)
 {
+  u8_t i;
+
   if(resolv_conn != NULL) {
     uip_udp_remove(resolv_conn);
   }
 
   resolv_conn = uip_udp_new(dnsserver, HTONS(53), dns_net_main);
+
+  /* Failures may have been caused by the old server, ask the new one
+     again if callbacks are waiting for the name. */
+  for(i = 0; i < RESOLV_ENTRIES; ++i)
+    if(names[i].state == STATE_ERROR && names[i].err != ERR_TOOLONG) {
+      if(resolv_waiting(&names[i])) {
+	names[i].state = STATE_NEW;
+	names[i].err = 0;
+      } else
+	names[i].state = STATE_UNUSED;
+    }
 }
 /*---------------------------------------------------------------------------*/
 /**
@@ -478,7 +692,7 @@ resolv_init(void)
   resolv_conf(&dnsserver);
 
   for(i = 0; i < RESOLV_ENTRIES; ++i) {
-    names[i].state = STATE_DONE;
+    names[i].state = STATE_UNUSED;
   }
 
 }
@@ -59,15 +59,28 @@
  */
 typedef void (*resolv_found_callback_t)(char *name, uip_ipaddr_t *ip);
 
+/** Cache statistics, lookups answered from the cache (hit) or not
+    (miss) and queries sent to the server. */
+struct resolv_stats {
+  u16_t hit;
+  u16_t miss;
+  u16_t query;
+};
+
+extern struct resolv_stats resolv_stats;
+
 /* Functions. */
 void resolv_periodic(void);
 void resolv_newdata(void);
+void resolv_tick(void);
 
 void resolv_conf(uip_ipaddr_t *dnsserver);
 uip_ipaddr_t *resolv_getserver(void);
 void resolv_init(void);
 uip_ipaddr_t *resolv_lookup(const char *name);
-void resolv_query(const char *name, resolv_found_callback_t callback);
+u8_t resolv_query(const char *name, resolv_found_callback_t callback);
+u8_t resolv_entry(u8_t i, const char **name, u16_t *ttl,
+                  uip_ipaddr_t **ipaddr);
 
 #endif /* __RESOLV_H__ */
 
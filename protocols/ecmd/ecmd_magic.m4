@@ -1,10 +1,18 @@
 dnl This m4 script uses quite a few divert levels, these are essentially:
 dnl   1: function prototypes
 dnl   2: char array in program space
-dnl   3: the function list
-dnl   4: function list trailer
 dnl   5: (optional) function implementations 
 dnl
+dnl   ecmd_divert_base and up: the function list
+dnl
+dnl The function list is emitted grouped by the first character of the
+dnl command name (one bucket per lower case letter, plus one bucket for
+dnl everything else).  Within a bucket the order of the ecmd_defs is kept,
+dnl therefore the parser still finds the first matching command, but only
+dnl has to look at the commands starting with the right letter.  The
+dnl bucket boundaries depend on the #ifdefs, hence they are counted by
+dnl the C compiler using an enum.
+dnl
 dnl ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 dnl
 dnl   Copyright (c) 2007 by Christian Dietrich <stettberger@dokucode.de>
@@ -43,7 +51,51 @@ divert(1)dnl
 divert(2)dnl
 
 /* Char array definitions follow */
-divert(3)dnl
+divert(-1)dnl
+
+dnl The function list has to be emitted after the timer code of
+dnl meta_magic.m4, which uses the divert levels up to about 1020.
+define(`ecmd_divert_base', 2000)
+define(`ecmd_buckets', `abcdefghijklmnopqrstuvwxyz')
+define(`ecmd_bucket_count', eval(len(ecmd_buckets) + 1))
+
+dnl ecmd_bucket_name(N): C identifier suffix of bucket N
+define(`ecmd_bucket_name', `ifelse(`$1', len(ecmd_buckets), `other',
+	`substr(ecmd_buckets, `$1', 1)')')
+
+dnl ecmd_bucket("name"): bucket number of the command name
+define(`ecmd_bucket', `_ecmd_bucket(index(ecmd_buckets, substr(`$1', 1, 1)))')
+define(`_ecmd_bucket', `ifelse(`$1', -1, len(ecmd_buckets), `$1')')
+
+dnl divert levels of the enum (counting) and the table part of a bucket
+define(`ecmd_enum_divert', `eval(ecmd_divert_base + 1 + $1)')
+define(`ecmd_table_divert', `eval(ecmd_divert_base + 2 + ecmd_bucket_count + $1)')
+define(`ecmd_trailer_divert', `eval(ecmd_divert_base + 2 + 2 * ecmd_bucket_count)')
+
+dnl ecmd_foreach_bucket(`text'): expand text for every bucket, with
+dnl `_bucket' defined to the bucket number
+define(`ecmd_foreach_bucket', `_ecmd_foreach_bucket(0, `$1')')
+define(`_ecmd_foreach_bucket', `ifelse(eval($1 < ecmd_bucket_count), 1,
+	`define(`_bucket', $1)$2`'_ecmd_foreach_bucket(incr($1), `$2')')')
+
+dnl ecmd_all_buckets(`line'): emit line to every bucket, enum and table
+define(`ecmd_all_buckets', `ecmd_foreach_bucket(
+	`divert(ecmd_enum_divert(_bucket))$1
+divert(ecmd_table_divert(_bucket))$1
+')divert(-1)')
+
+divert(ecmd_divert_base)dnl
+
+/* Position of the commands within ecmd_cmds, used to find the buckets */
+enum {
+divert(-1)dnl
+ecmd_foreach_bucket(`divert(ecmd_enum_divert(_bucket))dnl
+	ecmd_bucket_`'ecmd_bucket_name(_bucket),
+	ecmd_bucket_`'ecmd_bucket_name(_bucket)_ = ecmd_bucket_`'ecmd_bucket_name(_bucket) - 1,
+')
+divert(eval(ecmd_divert_base + 1 + ecmd_bucket_count))dnl
+	ecmd_bucket_end
+};
 
 /* Definition of function pointer array follows */
 const struct ecmd_command_t PROGMEM ecmd_cmds[] = {
@@ -52,34 +104,38 @@ divert(-1)dnl
 define(`ecmd_feature', `dnl
 divert(1)int16_t parse_cmd_$1 (char *cmd, char *output, uint16_t len);
 divert(2)const char PROGMEM ecmd_$1_text[] = $2;
-divert(3)	{ ecmd_$1_text, parse_cmd_$1 },
+divert(ecmd_enum_divert(ecmd_bucket($2)))	ecmd_index_$1,
+divert(ecmd_table_divert(ecmd_bucket($2)))	{ ecmd_$1_text, parse_cmd_$1 },
 divert(-1)')
 
 define(`ecmd_ifdef', `dnl
 divert(1)#ifdef $1
 divert(2)#ifdef $1
-divert(3)#ifdef $1
-divert(-1)')
+ecmd_all_buckets(`#ifdef $1')')
 
 define(`ecmd_ifndef', `dnl
 divert(1)#ifndef $1
 divert(2)#ifndef $1
-divert(3)#ifndef $1
-divert(-1)')
+ecmd_all_buckets(`#ifndef $1')')
 
 define(`ecmd_else', `dnl
 divert(1)#else
 divert(2)#else
-divert(3)#else
-divert(-1)')
+ecmd_all_buckets(`#else')')
 
 define(`ecmd_endif', `divert(1)#endif
 divert(2)#endif
-divert(3)#endif
-divert(-1)')
+ecmd_all_buckets(`#endif')')
 
-divert(4)dnl
+divert(ecmd_trailer_divert)dnl
         { NULL, NULL }
 };
+
+/* First command of every bucket within ecmd_cmds */
+const uint8_t PROGMEM ecmd_cmds_index[] = {
+ecmd_foreach_bucket(`	ecmd_bucket_`'ecmd_bucket_name(_bucket),
+')dnl
+	ecmd_bucket_end
+};
 divert(-1)dnl
 dnl yippie, we're done!
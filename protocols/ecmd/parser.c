@@ -42,6 +42,23 @@
 #define xstr(s) str(s)
 #define str(s) #s
 
+/* Check whether cmd starts with the command name text (in program space).
+   Returns the length of the name on match, 0 otherwise. */
+static uint8_t
+ecmd_match_P(const char *cmd, PGM_P text)
+{
+    uint8_t i = 0;
+    char c;
+
+    while ((c = pgm_read_byte(text + i)) != 0) {
+        if (cmd[i] != c)
+            return 0;
+        i++;
+    }
+
+    return i;
+}
+
 int16_t ecmd_parse_command(char *cmd, char *output, uint16_t len)
 {
 
@@ -91,35 +108,34 @@ int16_t ecmd_parse_command(char *cmd, char *output, uint16_t len)
 
     char *text = NULL;
     int16_t (*func)(char*, char*, uint16_t) = NULL;
-    uint8_t pos = 0;
 
-    while (1) {
+    /* only look at the commands starting with the same character */
+    uint8_t bucket = (uint8_t) (cmd[0] - 'a');
+    if (bucket > ECMD_BUCKET_OTHER)
+        bucket = ECMD_BUCKET_OTHER;
+
+    uint8_t pos = pgm_read_byte(&ecmd_cmds_index[bucket]);
+    uint8_t end = pgm_read_byte(&ecmd_cmds_index[bucket + 1]);
+
+    for (; pos < end; pos++) {
         /* load pointer to text */
         text = (char *)pgm_read_word(&ecmd_cmds[pos].name);
 
 #ifdef DEBUG_ECMD
         debug_printf("loaded text addres %p: \n", text);
-#endif
-
-        /* return if we reached the end of the array */
-        if (text == NULL)
-            break;
-
-#ifdef DEBUG_ECMD
         debug_printf("text is: \"%S\"\n", text);
 #endif
 
-        /* else compare texts */
-        if (memcmp_P(cmd, text, strlen_P(text)) == 0) {
+        /* compare texts */
+        uint8_t matchlen = ecmd_match_P(cmd, text);
+        if (matchlen) {
 #ifdef DEBUG_ECMD
             debug_printf("found match\n");
 #endif
-            cmd += strlen_P(text);
+            cmd += matchlen;
             func = (void *)pgm_read_word(&ecmd_cmds[pos].func);
             break;
         }
-
-        pos++;
     }
 
 #ifdef DEBUG_ECMD
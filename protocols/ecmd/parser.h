@@ -39,4 +39,11 @@ struct ecmd_command_t {
 /* automatically generated via meta system */
 extern const struct ecmd_command_t ecmd_cmds[];
 
+/* ecmd_cmds is grouped by the first character of the command name, one
+ * bucket per lower case letter plus one for the rest.  ecmd_cmds_index[n]
+ * holds the position of the first command of bucket n, the entry after the
+ * last bucket is the total number of commands (see ecmd_magic.m4). */
+#define ECMD_BUCKET_OTHER ('z' - 'a' + 1)
+extern const uint8_t ecmd_cmds_index[];
+
 #endif /* _ECMD_PARSER_H */
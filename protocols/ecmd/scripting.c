@@ -27,6 +27,7 @@
 #include <util/delay.h>
 
 #include "config.h"
+#include "core/pt/pt.h"
 #include "core/vfs/vfs.h"
 #include "protocols/ecmd/parser.h"
 #include "scripting.h"
@@ -34,13 +35,32 @@
 
 #include "protocols/ecmd/ecmd-base.h"
 
-typedef struct {
+typedef struct script {
   struct vfs_file_handle_t *handle;
   uint16_t linenumber;
   vfs_size_t filepointer;
+  // offsets of the first "indexed" lines, built when the script is called
+  uint8_t indexed;
+  uint16_t lineoffset[ECMD_SCRIPT_INDEX_LINES];
+  struct pt pt;
+  vfs_size_t filesize;
+  uint16_t run;           // lines executed since the last wait
+  uint16_t wait;          // remaining wait time in 20ms ticks
+  variables_t vars[ECMD_SCRIPT_MAX_VARIABLES];
+  struct script *caller;  // script waiting for this one to end
+  struct script *callee;  // script this one is waiting for
 } script_t;
 
-script_t current_script;
+static script_t scripts[ECMD_SCRIPT_SLOTS];
+
+// script whose line is being executed, NULL outside of scripts
+static script_t *current_script;
+
+// variables of the running script, the global ones outside of scripts
+static variables_t *
+script_vars(void){
+    return current_script ? current_script->vars : vars;
+}
 
 
 // read a line from file "handle", stored in "line", starting at "pos"
@@ -59,40 +79,102 @@ vfs_fgets(struct vfs_file_handle_t *handle, char *line, vfs_size_t pos){
     return i; // size until linebreak
 }
 
+// record the offsets of the lines of the script, so goto can jump
+// directly and readline knows the line lengths; "buf" is scratch space
+static void
+script_index(char *buf){
+    vfs_size_t pos = 0;
+    vfs_size_t readlen;
+    uint8_t i;
+
+    current_script->lineoffset[0] = 0;
+    current_script->indexed = 1;
+    vfs_fseek(current_script->handle, 0, SEEK_SET);
+
+    while (current_script->indexed < ECMD_SCRIPT_INDEX_LINES &&
+           (readlen = vfs_read(current_script->handle, buf,
+                               ECMD_INPUTBUF_LENGTH)) > 0) {
+      for (i = 0; i < readlen; i++) {
+        if (buf[i] != 0x0a)
+          continue;
+        if (pos + i + 1 > UINT16_MAX ||
+            current_script->indexed == ECMD_SCRIPT_INDEX_LINES)
+          goto out;
+        current_script->lineoffset[current_script->indexed++] = pos + i + 1;
+      }
+      pos += readlen;
+    }
+  out:
+    SCRIPTDEBUG("indexed %i lines\n", current_script->indexed - 1);
+}
+
 // read a line from script
 uint8_t
 readline(char *buf){
-    int8_t len = vfs_fgets(current_script.handle, buf, current_script.filepointer);
+    uint16_t ln = current_script->linenumber;
+    int8_t len;
+
+    if (ln + 1 < current_script->indexed) {
+      // length is known from the index, read just this line (truncated
+      // to the buffer, but continue after its real end)
+      uint16_t linelen = current_script->lineoffset[ln + 1]
+        - current_script->lineoffset[ln] - 1;
+      len = linelen < ECMD_INPUTBUF_LENGTH - 1 ? linelen : ECMD_INPUTBUF_LENGTH - 1;
+      vfs_fseek(current_script->handle, current_script->filepointer, SEEK_SET);
+      vfs_read(current_script->handle, buf, len);
+      buf[len] = 0;
+      SCRIPTDEBUG("readline: %s\n", buf);
+      current_script->filepointer += linelen + 1;
+      current_script->linenumber++;
+      return len;
+    }
+
+    len = vfs_fgets(current_script->handle, buf, current_script->filepointer);
     SCRIPTDEBUG("readline: %s\n", buf);
     if (len == -1 || len >= ECMD_INPUTBUF_LENGTH) {
       return 0;
     }
-    current_script.filepointer += len + 1;
-    current_script.linenumber++;
+    current_script->filepointer += len + 1;
+    current_script->linenumber++;
     return len;
 }
 
 int16_t
 parse_cmd_goto(char *cmd, char *output, uint16_t len)
 { 
-  uint8_t gotoline = 0;
+  uint16_t gotoline = 0;
   char line[ECMD_INPUTBUF_LENGTH];
 
-  if (current_script.handle == NULL) {
+  if (current_script == NULL || current_script->handle == NULL) {
       return ECMD_FINAL(snprintf_P(output, len, PSTR("no script")));
   }
   sscanf_P(cmd, PSTR("%i"), &gotoline);
 
-  SCRIPTDEBUG("current %i goto line %i\n", current_script.linenumber, gotoline);
+  SCRIPTDEBUG("current %i goto line %i\n", current_script->linenumber, gotoline);
+
+  if (gotoline < current_script->indexed) {
+    SCRIPTDEBUG("indexed\n");
+    current_script->linenumber = gotoline;
+    current_script->filepointer = current_script->lineoffset[gotoline];
+    return ECMD_FINAL_OK;
+  }
 
-  if (gotoline < current_script.linenumber) {
+  // not indexed, continue reading from the last indexed line
+  if (current_script->indexed &&
+      (gotoline < current_script->linenumber ||
+       current_script->linenumber < current_script->indexed - 1)) {
+    current_script->linenumber = current_script->indexed - 1;
+    current_script->filepointer =
+      current_script->lineoffset[current_script->linenumber];
+  }
+  if (gotoline < current_script->linenumber) {
     SCRIPTDEBUG("seek to 0\n");
-    vfs_fseek(current_script.handle, 0, SEEK_SET);
-    current_script.linenumber = 0;
-    current_script.filepointer = 0;
+    vfs_fseek(current_script->handle, 0, SEEK_SET);
+    current_script->linenumber = 0;
+    current_script->filepointer = 0;
   }
-  while ( (current_script.linenumber != gotoline ) && ( current_script.linenumber < ECMD_SCRIPT_MAXLINES )) {
-    SCRIPTDEBUG("seeking: current %i goto line %i\n", current_script.linenumber, gotoline);
+  while ( (current_script->linenumber != gotoline ) && ( current_script->linenumber < ECMD_SCRIPT_MAXLINES )) {
+    SCRIPTDEBUG("seeking: current %i goto line %i\n", current_script->linenumber, gotoline);
     if (readline(line)==0) {
       SCRIPTDEBUG("leaving\n");
       break;
@@ -104,55 +186,142 @@ parse_cmd_goto(char *cmd, char *output, uint16_t len)
 int16_t
 parse_cmd_exit(char *cmd, char *output, uint16_t len)
 {
-  if (current_script.handle == NULL) {
+  if (current_script == NULL || current_script->handle == NULL) {
       return ECMD_FINAL(snprintf_P(output, len, PSTR("no script")));
   }
-  vfs_close(current_script.handle);
-  current_script.handle = NULL;
-  current_script.linenumber = 0;
-  current_script.filepointer = 0;
+  vfs_close(current_script->handle);
+  current_script->handle = NULL;
+  current_script->linenumber = 0;
+  current_script->filepointer = 0;
+  current_script->indexed = 0;
   return ECMD_FINAL_OK;
 }
 
+// run the script "s" until it waits, ends or has executed
+// ECMD_SCRIPT_LINES_PER_PASS lines
+static
+PT_THREAD(script_thread(script_t *s))
+{
+  static char line[ECMD_INPUTBUF_LENGTH];
+  static char output[ECMD_INPUTBUF_LENGTH];
+  uint8_t lsize;
+  uint8_t lines = 0;
+
+  PT_BEGIN(&s->pt);
+
+  // run as long the file is open, we have not reached max lines and
+  // not the end of the file as we know it
+  while ( (s->handle != NULL) &&
+          (s->run < ECMD_SCRIPT_MAXLINES ) &&
+          (s->filesize > s->filepointer ) ) {
+
+    if (lines++ == ECMD_SCRIPT_LINES_PER_PASS) {
+      PT_YIELD(&s->pt);
+      lines = 0;
+      continue;
+    }
+
+    s->run++;
+    current_script = s;
+    lsize = readline(line);
+    SCRIPTDEBUG("(linenr:%i, pos:%i, bufsize:%i)\n", s->linenumber, s->filepointer, lsize);
+    SCRIPTDEBUG("exec: %s\n", line);
+    if (lsize != 0) {
+      ecmd_parse_command(line, output, sizeof(output));
+    }
+    current_script = NULL;
+
+    if (s->wait) {
+      PT_WAIT_UNTIL(&s->pt, s->wait == 0);
+      s->run = 0;
+      lines = 0;
+    }
+
+    // "call" runs the callee as a subroutine
+    if (s->callee) {
+      PT_WAIT_UNTIL(&s->pt, s->callee == NULL);
+      s->run = 0;
+      lines = 0;
+    }
+  }
+  SCRIPTDEBUG("end\n");
+
+  if (s->handle != NULL) {
+    vfs_close(s->handle);
+    s->handle = NULL;
+  }
+
+  // return the variables to the caller and let it continue
+  if (s->caller) {
+    memcpy(s->caller->vars, s->vars, sizeof(s->vars));
+    s->caller->callee = NULL;
+    s->caller = NULL;
+  }
+
+  PT_END(&s->pt);
+}
+
+// schedule all running scripts, called from the mainloop
+void
+ecmd_script_periodic(void){
+    for (uint8_t i = 0; i < ECMD_SCRIPT_SLOTS; i++)
+      if (scripts[i].handle != NULL)
+        script_thread(&scripts[i]);
+}
+
+// count down waits, called every 20ms
+void
+ecmd_script_tick(void){
+    for (uint8_t i = 0; i < ECMD_SCRIPT_SLOTS; i++)
+      if (scripts[i].wait)
+        scripts[i].wait--;
+}
+
 int16_t
 parse_cmd_call(char *cmd, char *output, uint16_t len)
 {
   char filename[10];
   char line[ECMD_INPUTBUF_LENGTH];
-  uint8_t lsize=0;
-  uint8_t run=0;
-  vfs_size_t filesize;
+  script_t *caller = current_script;
+  script_t *s = NULL;
+
+  for (uint8_t i = 0; i < ECMD_SCRIPT_SLOTS; i++)
+    if (scripts[i].handle == NULL) {
+      s = &scripts[i];
+      break;
+    }
+  if (s == NULL) {
+    return ECMD_FINAL(snprintf_P(output, len, PSTR("no free script slot")));
+  }
 
   sscanf_P(cmd, PSTR("%s"), &filename);  // should check for ".es" extention!
-  current_script.handle = vfs_open(filename);
+  s->handle = vfs_open(filename);
 
-  if (current_script.handle == NULL) {
+  if (s->handle == NULL) {
     SCRIPTDEBUG("%s not found\n", filename);
     return ECMD_FINAL(1);
   }
   
-  filesize = vfs_size(current_script.handle);
+  s->filesize = vfs_size(s->handle);
 
-  SCRIPTDEBUG("start %s from %i bytes\n", filename, filesize);
-  current_script.linenumber=0;
-  current_script.filepointer=0;
+  SCRIPTDEBUG("start %s from %i bytes\n", filename, s->filesize);
 
-  // open file as long it is open, we have not reached max lines and 
-  // not the end of the file as we know it
-  while ( (current_script.handle != NULL) && 
-          (run++ < ECMD_SCRIPT_MAXLINES ) && 
-          (filesize > current_script.filepointer ) ) {
+  // the script starts with a copy of the caller's variables
+  memcpy(s->vars, script_vars(), sizeof(s->vars));
 
-    lsize = readline(line);
-    SCRIPTDEBUG("(linenr:%i, pos:%i, bufsize:%i)\n", current_script.linenumber, current_script.filepointer, lsize);
-    SCRIPTDEBUG("exec: %s\n", line);
-    if (lsize != 0) {
-      ecmd_parse_command(line, output, len);
-    }
-  }
-    SCRIPTDEBUG("end\n");
+  current_script = s;
+  script_index(line);
+  current_script = caller;
 
-  parse_cmd_exit(cmd, output, len);
+  s->linenumber = 0;
+  s->filepointer = 0;
+  s->run = 0;
+  s->wait = 0;
+  s->callee = NULL;
+  s->caller = caller;
+  if (caller)
+    caller->callee = s;   // caller continues once s has ended
+  PT_INIT(&s->pt);
 
   return ECMD_FINAL_OK;
 }
@@ -166,30 +335,38 @@ parse_cmd_cat(char *cmd, char *output, uint16_t len)
   uint8_t run=0;
   vfs_size_t filesize;
 
+  script_t *caller = current_script;
+  script_t s;
+
   sscanf_P(cmd, PSTR("%s"), &filename);  // should check for ".es" extention!
-  current_script.handle = vfs_open(filename);
+  current_script = &s;
+  current_script->handle = vfs_open(filename);
 
-  if (current_script.handle == NULL) {
+  if (current_script->handle == NULL) {
     SCRIPTDEBUG("%s not found\n", filename);
+    current_script = caller;
     return ECMD_FINAL(1);
   }
   
-  filesize = vfs_size(current_script.handle);
+  filesize = vfs_size(current_script->handle);
 
   SCRIPTDEBUG("cat %s from %i bytes\n", filename, filesize);
-  current_script.linenumber=0;
-  current_script.filepointer=0;
+  current_script->indexed=0;
+  current_script->linenumber=0;
+  current_script->filepointer=0;
 
   // open file as long it is open, we have not reached max lines and 
   // not the end of the file as we know it
-  while ( (current_script.handle != NULL) && 
+  while ( (current_script->handle != NULL) && 
           (run++ < ECMD_SCRIPT_MAXLINES ) && 
-          (filesize > current_script.filepointer ) ) {
+          (filesize > current_script->filepointer ) ) {
 
     lsize = readline(line);
     SCRIPTDEBUG("cat: %s\n", line);
   }
 
+  vfs_close(current_script->handle);
+  current_script = caller;
   return ECMD_FINAL_OK;
 }
 
@@ -199,6 +376,11 @@ parse_cmd_wait(char *cmd, char *output, uint16_t len)
   uint16_t delay;
   sscanf_P(cmd, PSTR("%i"), &delay);
   SCRIPTDEBUG("wait %ims\n", delay);
+  if (current_script != NULL) {
+    // let the executor suspend the script
+    current_script->wait = ((uint32_t) delay + 19) / 20;
+    return ECMD_FINAL_OK;
+  }
   _delay_ms(delay);
   return ECMD_FINAL_OK;
 }
@@ -213,8 +395,8 @@ parse_cmd_set(char *cmd, char *output, uint16_t len)
     return ECMD_FINAL(snprintf_P(output, len, PSTR("max var exceed %i"), ECMD_SCRIPT_MAX_VARIABLES));
   }
 
-  strcpy(vars[pos].value, value);
-  return ECMD_FINAL(snprintf_P(output, len, PSTR("%%%i set to %s"), pos, vars[pos].value));
+  strcpy(script_vars()[pos].value, value);
+  return ECMD_FINAL(snprintf_P(output, len, PSTR("%%%i set to %s"), pos, script_vars()[pos].value));
 }
 
 int16_t
@@ -225,7 +407,7 @@ parse_cmd_get(char *cmd, char *output, uint16_t len)
   if (pos >= ECMD_SCRIPT_MAX_VARIABLES) {
     return ECMD_FINAL(snprintf_P(output, len, PSTR("max var exceed %i"), ECMD_SCRIPT_MAX_VARIABLES));
   }
-  return ECMD_FINAL(snprintf_P(output, len, PSTR("%s"), vars[pos].value));
+  return ECMD_FINAL(snprintf_P(output, len, PSTR("%s"), script_vars()[pos].value));
 }
 
 int16_t
@@ -236,8 +418,8 @@ parse_cmd_inc(char *cmd, char *output, uint16_t len)
   if (pos >= ECMD_SCRIPT_MAX_VARIABLES) {
     return ECMD_FINAL(snprintf_P(output, len, PSTR("max var exceed %i"), ECMD_SCRIPT_MAX_VARIABLES));
   }
-  uint16_t value = atoi(vars[pos].value);
-  itoa(value + 1, vars[pos].value, 10);
+  uint16_t value = atoi(script_vars()[pos].value);
+  itoa(value + 1, script_vars()[pos].value, 10);
   return ECMD_FINAL_OK;
 }
 
@@ -249,8 +431,8 @@ parse_cmd_dec(char *cmd, char *output, uint16_t len)
   if (pos >= ECMD_SCRIPT_MAX_VARIABLES) {
     return ECMD_FINAL(snprintf_P(output, len, PSTR("max var exceed %i"), ECMD_SCRIPT_MAX_VARIABLES));
   }
-  uint16_t value = atoi(vars[pos].value);
-  itoa(value - 1, vars[pos].value, 10);
+  uint16_t value = atoi(script_vars()[pos].value);
+  itoa(value - 1, script_vars()[pos].value, 10);
   return ECMD_FINAL_OK;
 }
 
@@ -280,7 +462,7 @@ parse_cmd_if(char *cmd, char *output, uint16_t len)
   if (cmpcmd[0]=='%') {
     uint8_t varpos = cmpcmd[1] - '0';
     // get variable and set it to output
-    strcpy(output, vars[varpos].value );
+    strcpy(output, script_vars()[varpos].value );
   } else { // if not, it is a command
     // execute cmp! and check output
     if (!ecmd_parse_command(cmpcmd, output, len)) {
@@ -373,7 +555,7 @@ ecmd_script_init_run(void){
   char cmd[] = CONF_ECMD_SCRIPT_AUTOSTART_NAME;
   char output[ECMD_SCRIPT_VARIABLE_LENGTH];
   SCRIPTDEBUG("auto run: %s\n", cmd);
-  return parse_cmd_call( cmd, output, sizeof(cmd));
+  return parse_cmd_call( cmd, output, sizeof(output));
 #else
   return ECMD_FINAL_OK;
 #endif
@@ -397,5 +579,7 @@ ecmd_script_init_run(void){
   ecmd_feature(rem, "rem",<any>, Remark for anything)
   ecmd_feature(echo, "echo ",<any>, Print out all arguments of echo)
   header(protocols/ecmd/scripting.h)
+  mainloop(ecmd_script_periodic)
+  timer(1, ecmd_script_tick())
   ifdef(`conf_ECMD_SCRIPT_AUTOSTART',`timer(50,ecmd_script_init_run())')
 */
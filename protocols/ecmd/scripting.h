@@ -45,6 +45,9 @@
 int16_t
 ecmd_script_init_run(void);
 
+void ecmd_script_periodic(void);
+void ecmd_script_tick(void);
+
 typedef struct {
   char value[ECMD_SCRIPT_VARIABLE_LENGTH];
 } variables_t;
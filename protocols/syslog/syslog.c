@@ -23,6 +23,7 @@
 
 #include <avr/pgmspace.h>
 #include <stdarg.h>
+#include <stdio.h>
 
 #include "protocols/uip/uip.h"
 #include "config.h"
@@ -33,86 +34,186 @@
 #include "syslog.h"
 #include "syslog_net.h"
 
+/* Maximum payload of one syslog datagram. */
+#define SYSLOG_DATAGRAM_SIZE (UIP_BUFSIZE - UIP_LLH_LEN - UIP_IPUDPH_LEN)
+
+#define SYSLOG_FACILITIES 24
+#define NO_RECORD 0xffff
+
+/* Queue of pending messages.  Every record is stored as one byte holding
+   the priority plus one (so it's never zero), followed by the
+   NUL-terminated text.  The queue is compacted after each datagram,
+   therefore new text can always be formatted in place at its end. */
+static char queue[MAX_DYNAMIC_SYSLOG_BUFFER];
+static uint16_t queue_len;
+
+/* Offset of the last record, if it's not yet terminated by a newline.
+   Further text of the same priority is appended to it. */
+static uint16_t open_record = NO_RECORD;
+
+/* Number of messages lost since the last datagram, either due to a full
+   queue or due to rate limiting. */
+static uint16_t syslog_dropped;
+
+#ifdef SYSLOG_RFC5424_SUPPORT
+static uint16_t syslog_sequence;
+#endif
+
+#if SYSLOG_RATE_LIMIT > 0
+/* Messages started per facility within the current second. */
+static uint8_t syslog_rate[SYSLOG_FACILITIES];
+#endif
 
-static char send_buffer[MAX_DYNAMIC_SYSLOG_BUFFER + 1];
 extern uip_udp_conn_t *syslog_conn;
 static struct SyslogCallbackCtx syslog_callbacks[SYSLOG_CALLBACKS];
 
-static void syslog_send_cb_P(void *data) 
-{
-  strcpy_P(uip_appdata, data);
-  uip_udp_send(strlen_P(data));
-}
-
 static void syslog_send_cb(void *data) 
 {
   char *p = data;
 
   strcpy(uip_appdata, p);
   uip_udp_send(strlen(p));
+}
+
+
+/* Find the place for new text of priority PRI, return its offset within
+   the queue or NO_RECORD if the message has to be dropped. */
+static uint16_t
+syslog_begin (uint8_t pri)
+{
+  if (open_record != NO_RECORD && queue[open_record] == pri + 1)
+    return queue_len - 1;	/* overwrite terminating NUL */
+
+  if (queue_len + 2 >= MAX_DYNAMIC_SYSLOG_BUFFER)
+    goto drop;
+
+#if SYSLOG_RATE_LIMIT > 0
+  uint8_t facility = pri >> 3;
+  if (facility < SYSLOG_FACILITIES) {
+    if (syslog_rate[facility] >= SYSLOG_RATE_LIMIT)
+      goto drop;
+    syslog_rate[facility]++;
+  }
+#endif
+
+  queue[queue_len] = pri + 1;
+  return queue_len + 1;
+
+ drop:
+  syslog_dropped++;
+  return NO_RECORD;
+}
+
 
-  if (p == send_buffer)
-    p[0] = 0;
+/* Account LEN bytes of text written at offset POS.  If the text didn't
+   fit, the record is rolled back and counted as dropped. */
+static uint8_t
+syslog_commit (uint16_t pos, uint16_t len)
+{
+  if (pos + len >= MAX_DYNAMIC_SYSLOG_BUFFER) {
+    if (pos == queue_len - 1)
+      queue[pos] = 0;		/* restore open record */
+    syslog_dropped++;
+    return 0;
+  }
+
+  if (! len)
+    return 1;
+
+  if (pos != queue_len - 1)
+    open_record = pos - 1;
+  queue_len = pos + len + 1;
+
+  if (queue[pos + len - 1] == '\n')
+    open_record = NO_RECORD;
+  return 1;
+}
+
+
+static uint8_t
+syslog_vsendf (uint8_t pri, uint8_t progmem, const char *message, va_list va)
+{
+  uint16_t pos = syslog_begin (pri);
+  if (pos == NO_RECORD)
+    return 0;
+
+  int len;
+  if (progmem)
+    len = vsnprintf_P (queue + pos, MAX_DYNAMIC_SYSLOG_BUFFER - pos,
+		       message, va);
+  else
+    len = vsnprintf (queue + pos, MAX_DYNAMIC_SYSLOG_BUFFER - pos,
+		     message, va);
+
+  return syslog_commit (pos, len < 0 ? 0 : len);
 }
 
 
 uint8_t 
 syslog_send_P(PGM_P message)
 {
-  return syslog_insert_callback(syslog_send_cb_P, (void *)message);
+  uint16_t pos = syslog_begin (SYSLOG_DEFAULT_PRI);
+  if (pos == NO_RECORD)
+    return 0;
+
+  uint16_t len = strlen_P (message);
+  if (pos + len < MAX_DYNAMIC_SYSLOG_BUFFER)
+    strcpy_P (queue + pos, message);
+
+  return syslog_commit (pos, len);
 }
 
 uint8_t 
 syslog_send(const char *message)
 {
-  uint16_t offset = strlen (send_buffer);
-
-  if (strlen (message) + offset + 1 > MAX_DYNAMIC_SYSLOG_BUFFER)
+  uint16_t pos = syslog_begin (SYSLOG_DEFAULT_PRI);
+  if (pos == NO_RECORD)
     return 0;
 
-  strcat (send_buffer + offset, message);
+  uint16_t len = strlen (message);
+  if (pos + len < MAX_DYNAMIC_SYSLOG_BUFFER)
+    strcpy (queue + pos, message);
 
-  if (! offset)
-    /* If there used to be a few bytes in the buffer already, we don't have
-       to insert the callback, since it should have been added already. */
-    return syslog_insert_callback(syslog_send_cb, (void *)send_buffer);
-  return 1;
+  return syslog_commit (pos, len);
 }
 
 uint8_t 
 syslog_sendf(const char *message, ...)
 {
   va_list va;
-  uint16_t offset = strlen (send_buffer);
+  uint8_t ret;
 
   va_start(va, message);
-  vsnprintf(send_buffer + offset, MAX_DYNAMIC_SYSLOG_BUFFER - offset, 
-            message, va);
+  ret = syslog_vsendf (SYSLOG_DEFAULT_PRI, 0, message, va);
   va_end(va);
 
-  send_buffer[MAX_DYNAMIC_SYSLOG_BUFFER] = 0;
-
-  if (!offset)
-    return syslog_insert_callback(syslog_send_cb, (void *)send_buffer);
-  return 1;
+  return ret;
 }
 
 uint8_t
 syslog_sendf_P(PGM_P message, ...)
 {
   va_list va;
-  uint16_t offset = strlen (send_buffer);
+  uint8_t ret;
 
   va_start(va, message);
-  vsnprintf_P(send_buffer + offset, MAX_DYNAMIC_SYSLOG_BUFFER - offset,
-            message, va);
+  ret = syslog_vsendf (SYSLOG_DEFAULT_PRI, 1, message, va);
   va_end(va);
 
-  send_buffer[MAX_DYNAMIC_SYSLOG_BUFFER] = 0;
+  return ret;
+}
 
-  if (!offset)
-    return syslog_insert_callback(syslog_send_cb, (void *)send_buffer);
-  return 1;
+uint8_t
+syslog_sendf_pri_P(uint8_t pri, PGM_P message, ...)
+{
+  va_list va;
+  uint8_t ret;
+
+  va_start(va, message);
+  ret = syslog_vsendf (pri, 1, message, va);
+  va_end(va);
+
+  return ret;
 }
 
 uint8_t 
@@ -122,6 +223,55 @@ syslog_send_ptr(void *message)
 }
 
 
+/* Fill the datagram with as many queued records of the same priority as
+   fit, then remove them from the queue. */
+static void
+syslog_pack (void)
+{
+  char *p = uip_appdata;
+  uint8_t pri = queue[0];
+  uint16_t off = 0;
+  uint16_t len = 0;
+
+#ifdef SYSLOG_RFC5424_SUPPORT
+  if (! ++syslog_sequence)
+    syslog_sequence = 1;
+  len = snprintf_P (p, SYSLOG_DATAGRAM_SIZE,
+		    PSTR ("<%u>1 - " CONF_HOSTNAME " ethersex - - "
+			  "[meta sequenceId=\"%u\"] "),
+		    pri - 1, syslog_sequence);
+#endif
+
+  if (syslog_dropped) {
+    len += snprintf_P (p + len, SYSLOG_DATAGRAM_SIZE - len,
+		       PSTR ("(%u messages dropped)\n"), syslog_dropped);
+    syslog_dropped = 0;
+  }
+
+  while (off < queue_len && queue[off] == pri) {
+    uint16_t n = strlen (queue + off + 1);
+
+    if (len + n > SYSLOG_DATAGRAM_SIZE) {
+      if (off)
+	break;			/* next datagram */
+      n = SYSLOG_DATAGRAM_SIZE - len;	/* truncate single huge record */
+    }
+
+    memcpy (p + len, queue + off + 1, n);
+    len += n;
+    off += strlen (queue + off + 1) + 2;
+  }
+
+  queue_len -= off;
+  memmove (queue, queue + off, queue_len);
+
+  if (open_record != NO_RECORD)
+    open_record = open_record < off ? NO_RECORD : open_record - off;
+
+  uip_udp_send (len);
+}
+
+
 void
 syslog_flush (void)
 {
@@ -141,6 +291,9 @@ syslog_flush (void)
       break;
     }
 
+  if (! uip_slen && queue_len)
+    syslog_pack ();
+
   if (! uip_slen)
     return;
 
@@ -152,6 +305,15 @@ syslog_flush (void)
 }
 
 
+void
+syslog_periodic (void)
+{
+#if SYSLOG_RATE_LIMIT > 0
+  memset (syslog_rate, 0, sizeof (syslog_rate));
+#endif
+}
+
+
 uint8_t
 syslog_insert_callback(syslog_callback_t callback, void *data)
 {
@@ -169,4 +331,5 @@ syslog_insert_callback(syslog_callback_t callback, void *data)
   -- Ethersex META --
   header(protocols/syslog/syslog.h)
   mainloop(syslog_flush)
+  timer(50, syslog_periodic())
 */
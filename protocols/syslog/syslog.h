@@ -29,13 +29,31 @@
 
 #define MAX_DYNAMIC_SYSLOG_BUFFER 500
 
+/* Facilities and severities as of RFC5424, section 6.2.1 */
+#define SYSLOG_KERN     0
+#define SYSLOG_USER     1
+#define SYSLOG_DAEMON   3
+#define SYSLOG_LOCAL0   16
+#define SYSLOG_LOCAL7   23
+
+#define SYSLOG_ERR      3
+#define SYSLOG_WARNING  4
+#define SYSLOG_NOTICE   5
+#define SYSLOG_INFO     6
+#define SYSLOG_DEBUG    7
+
+#define SYSLOG_PRI(facility, severity) (((facility) << 3) | (severity))
+#define SYSLOG_DEFAULT_PRI SYSLOG_PRI(SYSLOG_USER, SYSLOG_NOTICE)
+
 uint8_t syslog_send_P(PGM_P message);
 uint8_t syslog_send(const char *message);
 uint8_t syslog_sendf(const char *message, ...);
 uint8_t syslog_sendf_P(PGM_P message, ...);
+uint8_t syslog_sendf_pri_P(uint8_t pri, PGM_P message, ...);
 uint8_t syslog_send_ptr(void *message);
 
 void syslog_flush (void);
+void syslog_periodic (void);
 
 /* Check the ARP/Neighbor cache for the necessary entries;
    return 0 if it's safe to send syslog data. */
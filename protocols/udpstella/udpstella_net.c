@@ -34,6 +34,7 @@
   STELLA_SET_FADE,
   STELLA_SET_FLASHY,
   STELLA_SET_IMMEDIATELY_RELATIVE
+  STELLA_SET_GAMMA (value 0/1 switches gamma correction off/on)
   STELLA_GETALL
 */
 
@@ -126,6 +126,13 @@ typedef unsigned short uip_stats_t;
 #define UIP_ARCH_ADD32           0
 #define UIP_ARCH_CHKSUM          0
 
+/* Let the DMA of the enc28j60 sum up received packets, which still reside
+   in its buffer memory.  Returns zero if it cannot, see enc28j60.c */
+#ifdef ENC28J60_DMA_CHKSUM_SUPPORT
+uint8_t enc28j60_rx_chksum(uint16_t *sum, uint16_t offset, uint16_t len);
+#  define UIP_ARCH_RXCHKSUM(sum, offset, len) enc28j60_rx_chksum(sum, offset, len)
+#endif
+
 #define RFM12_LLH_LEN            2
 
 
@@ -93,6 +93,10 @@
 
 #include <string.h>
 
+#ifdef UIP_SPLIT_SUPPORT
+#include "uip_router.h"
+#endif
+
 #define noinline __attribute__((noinline))
 
 /*---------------------------------------------------------------------------*/
@@ -181,6 +185,12 @@ uip_udp_conn_t *uip_udp_conn;
 uip_udp_conn_t uip_udp_conns[UIP_UDP_CONNS];
 #endif /* UIP_UDP */
 
+#ifdef UIP_SPLIT_SUPPORT
+u8_t uip_split_segment;      /* Set by uip_split(), the TCP checksum
+				of the segment is left to
+				uip_split_output(). */
+#endif
+
 #if !UIP_CONF_IPV6
 static u16_t ipid;           /* Ths ipid variable is an increasing
 				number that is used for the IP ID
@@ -342,6 +352,11 @@ uip_ipchksum(void)
 #endif /* !UIP_CONF_IPV6 */
 #endif /* UIP_ARCH_IPCHKSUM */
 /*---------------------------------------------------------------------------*/
+#ifdef UIP_ARCH_RXCHKSUM
+/* Set while checking the checksum of a received packet. */
+static u8_t rxchksum;
+#endif /* UIP_ARCH_RXCHKSUM */
+
 u16_t
 upper_layer_chksum(u8_t proto)
 {
@@ -362,12 +377,32 @@ upper_layer_chksum(u8_t proto)
   sum = chksum(sum, (u8_t *)&BUF->srcipaddr[0], 2 * sizeof(uip_ipaddr_t));
 
   /* Sum TCP header and data. */
+#ifdef UIP_ARCH_RXCHKSUM
+  if(!rxchksum || !UIP_ARCH_RXCHKSUM(&sum, UIP_IPH_LEN + UIP_LLH_LEN,
+				     upper_layer_len))
+#endif /* UIP_ARCH_RXCHKSUM */
   sum = chksum(sum, &uip_buf[UIP_IPH_LEN + UIP_LLH_LEN],
 	       upper_layer_len);
 
   return (sum == 0) ? 0xffff : htons(sum);
 }
 /*---------------------------------------------------------------------------*/
+#ifdef UIP_ARCH_RXCHKSUM
+static u16_t
+uip_rxchksum(u8_t proto)
+{
+  u16_t sum;
+
+  rxchksum = 1;
+  sum = upper_layer_chksum(proto);
+  rxchksum = 0;
+
+  return sum;
+}
+#else /* UIP_ARCH_RXCHKSUM */
+#define uip_rxchksum(proto) upper_layer_chksum(proto)
+#endif /* UIP_ARCH_RXCHKSUM */
+/*---------------------------------------------------------------------------*/
 #if UIP_CONF_IPV6
 static u16_t
 uip_icmp6chksum(void)
@@ -671,6 +706,10 @@ uip_process(u8_t flag)
 
   uip_sappdata = uip_appdata = &uip_buf[UIP_IPTCPH_LEN + UIP_LLH_LEN];
 
+#ifdef UIP_SPLIT_SUPPORT
+  uip_split_segment = 0;
+#endif
+
 #if UIP_TCP
   register uip_conn_t *uip_connr = uip_conn;
 
@@ -1100,7 +1139,7 @@ ip_check_end:
 #if UIP_UDP_CHECKSUMS
   uip_len = uip_len - UIP_IPUDPH_LEN;
   uip_appdata = &uip_buf[UIP_LLH_LEN + UIP_IPUDPH_LEN];
-  if(UDPBUF->udpchksum != 0 && uip_udpchksum() != 0xffff) {
+  if(UDPBUF->udpchksum != 0 && uip_rxchksum(UIP_PROTO_UDP) != 0xffff) {
     UIP_STAT(++uip_stat.udp.drop);
     UIP_STAT(++uip_stat.udp.chkerr);
     UIP_LOG("udp: bad checksum.");
@@ -1190,8 +1229,8 @@ ip_check_end:
 
   /* Start of TCP input header processing code. */
 
-  if(uip_tcpchksum() != 0xffff) {   /* Compute and check the TCP
-				       checksum. */
+  /* Compute and check the TCP checksum. */
+  if(uip_rxchksum(UIP_PROTO_TCP) != 0xffff) {
     UIP_STAT(++uip_stat.tcp.drop);
     UIP_STAT(++uip_stat.tcp.chkerr);
     UIP_LOG("tcp: bad checksum.");
@@ -1893,9 +1932,15 @@ ip_check_end:
 
   BUF->urgp[0] = BUF->urgp[1] = 0;
 
-  /* Calculate TCP checksum. */
-  BUF->tcpchksum = 0;
-  BUF->tcpchksum = ~(uip_tcpchksum());
+  /* Calculate TCP checksum, unless uip_split_output() does it for the
+     halves of the segment. */
+#if defined(UIP_SPLIT_SUPPORT) && defined(router_output_segment)
+  if(!uip_split_segment)
+#endif
+  {
+    BUF->tcpchksum = 0;
+    BUF->tcpchksum = ~(uip_tcpchksum());
+  }
 
 #endif /* UIP_TCP */   //FIXME
 
@@ -1946,6 +1991,84 @@ uip_send(const void *data, int len)
   }
 }
 
+/*---------------------------------------------------------------------------*/
+#if defined(UIP_SPLIT_SUPPORT) && defined(router_output_segment)
+/* Fix up length and checksums after the payload of the TCP segment in
+   uip_buf has been changed. */
+static void
+uip_split_chksum(void)
+{
+#if UIP_CONF_IPV6
+  BUF->len[0] = ((uip_len - UIP_IPH_LEN) >> 8);
+  BUF->len[1] = ((uip_len - UIP_IPH_LEN) & 0xff);
+#else /* UIP_CONF_IPV6 */
+  BUF->len[0] = (uip_len >> 8);
+  BUF->len[1] = (uip_len & 0xff);
+#endif /* UIP_CONF_IPV6 */
+
+  BUF->tcpchksum = 0;
+  BUF->tcpchksum = ~(uip_tcpchksum());
+
+#if !UIP_CONF_IPV6
+  ++ipid;
+  BUF->ipid[0] = ipid >> 8;
+  BUF->ipid[1] = ipid & 0xff;
+  BUF->ipchksum = 0;
+  BUF->ipchksum = ~(uip_ipchksum());
+#endif /* !UIP_CONF_IPV6 */
+}
+
+/* uIP only has one segment in flight per connection, so the peer usually
+   delays its ACK for up to 200ms.  Sending a data segment marked with
+   uip_split() as two halves makes it acknowledge immediately.  The
+   application still sees a single segment and regenerates it as a whole
+   on rexmit. */
+uint8_t
+uip_split_output(void)
+{
+  u16_t tcplen, len1;
+  u8_t retval;
+
+  if(!uip_split_segment || BUF->proto != UIP_PROTO_TCP) {
+    return router_output_segment();
+  }
+
+  uip_split_segment = 0;
+
+  if((BUF->flags & (TCP_SYN | TCP_FIN | TCP_RST))
+     || (BUF->tcpoffset >> 4) != UIP_TCPH_LEN / 4
+     || uip_len < UIP_TCPIP_HLEN + 2) {
+    /* Not split after all, add the checksum left out by uip_process(). */
+    BUF->tcpchksum = 0;
+    BUF->tcpchksum = ~(uip_tcpchksum());
+    return router_output_segment();
+  }
+
+  tcplen = uip_len - UIP_TCPIP_HLEN;
+  len1 = tcplen / 2;
+
+  /* First half. */
+  uip_len = UIP_TCPIP_HLEN + len1;
+  uip_split_chksum();
+  retval = router_output_segment();
+  if(retval) {
+    /* Replaced by an arp request, the segment is retransmitted later. */
+    return retval;
+  }
+
+  /* Second half, the output path has changed the link level header
+     only. */
+  memmove(&uip_buf[UIP_LLH_LEN + UIP_TCPIP_HLEN],
+	  &uip_buf[UIP_LLH_LEN + UIP_TCPIP_HLEN + len1], tcplen - len1);
+  uip_add32(BUF->seqno, len1);
+  memcpy(BUF->seqno, uip_acc32, 4);
+
+  uip_len = UIP_TCPIP_HLEN + tcplen - len1;
+  uip_split_chksum();
+  return router_output_segment();
+}
+#endif /* UIP_SPLIT_SUPPORT */
+
 /** @} */
 
 /*
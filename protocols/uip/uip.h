@@ -567,6 +567,24 @@ uip_conn_t *uip_connect(uip_ipaddr_t *ripaddr, u16_t port, uip_conn_callback_t c
  */
 void uip_send(const void *data, int len);
 
+/**
+ * Send the data segment of the current uip_send() call as two packets.
+ *
+ * uIP has only one segment in flight per connection, so most hosts
+ * delay their ACK for up to 200ms.  Two packets make them acknowledge
+ * at once, which speeds up bulk transfers.  Only takes effect with
+ * UIP_SPLIT_SUPPORT, the application still regenerates the whole
+ * segment on rexmit.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_SPLIT_SUPPORT
+extern u8_t uip_split_segment;
+#define uip_split()         (uip_split_segment = 1)
+#else
+#define uip_split()
+#endif
+
 /**
  * The length of any incoming data that is currently avaliable (if avaliable)
  * in the uip_appdata buffer.
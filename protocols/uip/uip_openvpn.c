@@ -47,6 +47,44 @@ static uip_udp_conn_t *openvpn_conn;
 static unsigned char *key = CONF_OPENVPN_KEY;
 static cast5_ctx_t ctx;
 
+/* Check the packet-id against the sliding window of the packets seen
+   so far.  A new timestamp means that the peer has restarted its
+   sequence numbers.  Return non-zero, if the packet is a replay or too
+   old to tell. */
+static int
+openvpn_replay_check (uint32_t seqno, uint32_t timestamp)
+{
+  struct openvpn_connection_state_t *state = &uip_udp_conn->appstate.openvpn;
+
+  if (timestamp < state->seen_timestamp)
+    return 1;
+
+  if (timestamp > state->seen_timestamp)
+    {
+      state->seen_timestamp = timestamp;
+      state->seen_seqno = seqno;
+      state->seen_bitmap = 1;
+      return 0;
+    }
+
+  if (seqno > state->seen_seqno)
+    {
+      uint32_t diff = seqno - state->seen_seqno;
+      state->seen_bitmap = diff < OPENVPN_REPLAY_WINDOW
+	? (state->seen_bitmap << diff) | 1 : 1;
+      state->seen_seqno = seqno;
+      return 0;
+    }
+
+  uint32_t diff = state->seen_seqno - seqno;
+  if (diff >= OPENVPN_REPLAY_WINDOW
+      || (state->seen_bitmap & ((uint32_t) 1 << diff)))
+    return 1;
+
+  state->seen_bitmap |= (uint32_t) 1 << diff;
+  return 0;
+}
+
 /* Decrypt the cast5 encrypted OpenVPN packet and verify the packet
    id.  Return non-zero on error. */
 int
@@ -79,16 +117,7 @@ openvpn_decrypt_and_verify (void)
 
   /* verify packet-id */
   uint32_t *packet_id = (uint32_t *) (uip_appdata + OPENVPN_HMAC_LLH_LEN + 8);
-  if (HTONL(packet_id[1]) <= uip_udp_conn->appstate.openvpn.seen_timestamp)
-    {
-      if (HTONL(packet_id[0]) <= uip_udp_conn->appstate.openvpn.seen_seqno)
-	return 1;
-    }
-
-  uip_udp_conn->appstate.openvpn.seen_seqno = HTONL(packet_id[0]);
-  uip_udp_conn->appstate.openvpn.seen_timestamp = HTONL(packet_id[1]);
-
-  return 0;
+  return openvpn_replay_check (HTONL(packet_id[0]), HTONL(packet_id[1]));
 }
 
 /* The length in uip_slen is already including the extra
@@ -140,29 +169,36 @@ openvpn_encrypt (void)
 #ifdef MD5_SUPPORT
 #include "core/crypto/md5.h"
 
-void
-openvpn_hmac_calc (unsigned char *dest, unsigned char *src, uint16_t len)
+/* MD5 states after the key block of the inner and outer hash. */
+static md5_ctx_t hmac_inner, hmac_outer;
+
+static void
+openvpn_hmac_init (void)
 {
   const unsigned char *hmac_key = (const unsigned char *)CONF_OPENVPN_HMAC_KEY;
   unsigned char buf[64];
 
-  /* perform inner part of hmac */
-  md5_ctx_t ctx_inner;
-  md5_init (&ctx_inner);
-
   for (int i = 0; i < 16; i ++) buf[i] = hmac_key[i] ^ 0x36;
   for (int i = 16; i < 64; i ++) buf[i] = 0x36;
 
-  md5_nextBlock (&ctx_inner, buf);
+  md5_init (&hmac_inner);
+  md5_nextBlock (&hmac_inner, buf);
+
+  for (int i = 0; i < 64; i ++) buf[i] ^= 0x36 ^ 0x5c;
+
+  md5_init (&hmac_outer);
+  md5_nextBlock (&hmac_outer, buf);
+}
+
+void
+openvpn_hmac_calc (unsigned char *dest, unsigned char *src, uint16_t len)
+{
+  /* perform inner part of hmac */
+  md5_ctx_t ctx_inner = hmac_inner;
   md5_lastBlock (&ctx_inner, src, len << 3);
 
   /* perform outer part of hmac */
-  md5_ctx_t ctx_outer;
-  md5_init (&ctx_outer);
-
-  for (int i = 0; i < 16; i ++) buf[i] = hmac_key[i] ^ 0x5c;
-  for (int i = 16; i < 64; i ++) buf[i] = 0x5c;
-  md5_nextBlock (&ctx_outer, buf);
+  md5_ctx_t ctx_outer = hmac_outer;
   md5_lastBlock (&ctx_outer, (void *) &ctx_inner.a[0], 128);
 
   memmove (dest, (void *) &ctx_outer.a[0], 16);
@@ -189,6 +225,7 @@ openvpn_hmac_verify (void)
 		     uip_slen - OPENVPN_HMAC_LLH_LEN)
 
 #else /* !MD5_SUPPORT */
+#define openvpn_hmac_init() do { (void) 0; } while(0)
 #define openvpn_hmac_verify() 0
 #define openvpn_hmac_create() do { (void) 0; } while(0)
 #endif
@@ -298,6 +335,7 @@ openvpn_init (void)
 #ifdef CAST5_SUPPORT
   cast5_init(key, 128, &ctx);
 #endif
+  openvpn_hmac_init ();
 
   /* Initialize OpenVPN stack IP config, if necessary. */
   set_CONF_OPENVPN_IP(&ip);
@@ -328,6 +366,7 @@ openvpn_init (void)
   openvpn_conn->appstate.openvpn.next_seqno = 1;
   openvpn_conn->appstate.openvpn.seen_seqno = 0;
   openvpn_conn->appstate.openvpn.seen_timestamp = 0;
+  openvpn_conn->appstate.openvpn.seen_bitmap = 0;
 }
 
 /*
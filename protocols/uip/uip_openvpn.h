@@ -36,10 +36,15 @@ void openvpn_txstart (void);
 /* The port number to use for OpenVPN. */
 #define OPENVPN_PORT CONF_OPENVPN_PORT
 
+/* Number of packets a packet may be late, before it is taken as replay. */
+#define OPENVPN_REPLAY_WINDOW 32
+
 struct openvpn_connection_state_t {
   uint32_t next_seqno;
   uint32_t seen_seqno;
   uint32_t seen_timestamp;
+  /* Bit n is set, if packet seen_seqno - n has been received. */
+  uint32_t seen_bitmap;
 };
 
 #endif /* OPENVPN_SUPPORT */
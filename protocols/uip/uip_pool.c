@@ -0,0 +1,125 @@
+/*
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "config.h"
+#include "uip.h"
+#include "uip_router.h"
+#include "uip_pool.h"
+
+enum {
+  POOL_FREE,
+  POOL_BUSY,			/* handed out, interface is receiving */
+  POOL_QUEUED,			/* waiting for uip_buf */
+};
+
+struct uip_pool_buf {
+  uint8_t state;
+  uint8_t stack;
+  uint16_t len;
+  uint8_t data[UIP_BUFSIZE + 2];
+};
+
+static struct uip_pool_buf pool[UIP_POOL_BUFFERS];
+
+/* Queued buffers in order of arrival. */
+static uint8_t queue[UIP_POOL_BUFFERS];
+static uint8_t queue_len;
+
+#define POOL_BUF(buf) \
+  ((struct uip_pool_buf *) ((buf) - offsetof (struct uip_pool_buf, data)))
+
+
+uint8_t *
+uip_pool_alloc (void)
+{
+  uint8_t *buf = NULL;
+  uint8_t sreg = SREG; cli ();
+
+  for (uint8_t i = 0; i < UIP_POOL_BUFFERS; i ++)
+    if (pool[i].state == POOL_FREE)
+      {
+	pool[i].state = POOL_BUSY;
+	buf = pool[i].data;
+	break;
+      }
+
+  SREG = sreg;
+  return buf;
+}
+
+
+void
+uip_pool_free (uint8_t *buf)
+{
+  POOL_BUF (buf)->state = POOL_FREE;
+}
+
+
+void
+uip_pool_queue (uint8_t *buf, uint8_t stack, uint16_t len)
+{
+  struct uip_pool_buf *p = POOL_BUF (buf);
+  p->stack = stack;
+  p->len = len;
+
+  uint8_t sreg = SREG; cli ();
+  p->state = POOL_QUEUED;
+  queue[queue_len ++] = p - pool;
+  SREG = sreg;
+}
+
+
+void
+uip_pool_process (void)
+{
+  if (!queue_len || uip_buf_lock ())
+    return;
+
+  struct uip_pool_buf *p = &pool[queue[0]];
+  uint8_t stack = p->stack;
+  memcpy (uip_buf, p->data, p->len);
+  uip_len = p->len;
+
+  uint8_t sreg = SREG; cli ();
+  queue_len --;
+  memmove (queue, queue + 1, queue_len);
+  p->state = POOL_FREE;
+  SREG = sreg;
+
+  router_input (stack);
+
+  if (uip_len == 0)
+    uip_buf_unlock ();		/* The stack didn't generate any data
+				   that has to be sent back. */
+  else
+    router_output ();		/* Application has generated output,
+				   send it out. */
+}
+
+/*
+  -- Ethersex META --
+  header(protocols/uip/uip_pool.h)
+  mainloop(uip_pool_process)
+*/
@@ -0,0 +1,52 @@
+/*
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef UIP_POOL_H
+#define UIP_POOL_H
+
+#include "config.h"
+#ifdef UIP_POOL_SUPPORT
+
+#include <stdint.h>
+
+/* Receive buffers for interfaces that have to take a packet while
+   uip_buf is locked by somebody else.  A pool buffer is laid out like
+   uip_buf, i.e. the interface stores the packet at its bridge offset.
+   Once received, the buffer is queued and copied to uip_buf from the
+   mainloop, as soon as uip_buf can be locked.
+
+   All functions may be called from interrupt context. */
+
+/* Take a free buffer from the pool.  Returns NULL if all buffers are
+   in use. */
+uint8_t *uip_pool_alloc (void);
+
+/* Return BUF to the pool without passing it to the stack. */
+void uip_pool_free (uint8_t *buf);
+
+/* Queue BUF for router_input.  LEN is the number of bytes, including
+   the LLH, just as router_input expects it in uip_len. */
+void uip_pool_queue (uint8_t *buf, uint8_t stack, uint16_t len);
+
+/* Pass the oldest queued packet to the stack, if uip_buf is free. */
+void uip_pool_process (void);
+
+#endif /* UIP_POOL_SUPPORT */
+#endif /* not UIP_POOL_H */
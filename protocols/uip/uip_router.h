@@ -52,11 +52,11 @@ void router_output(void);
 
 #if defined(ENC28J60_SUPPORT)
 #  include "network.h"
-#  define router_output() enc28j60_txstart()
+#  define router_output_segment() enc28j60_txstart()
 
 #elif defined(TAP_SUPPORT)
 #  include "core/host/tap.h"
-#  define router_output() tap_txstart()
+#  define router_output_segment() tap_txstart()
 
 #elif defined(RFM12_IP_SUPPORT)
 #  include "hardware/radio/rfm12/rfm12.h"
@@ -72,6 +72,17 @@ void router_output(void);
 
 #endif
 
+#ifdef router_output_segment
+#  ifdef UIP_SPLIT_SUPPORT
+/* Send the packet in uip_buf, splitting TCP data segments in two halves.
+   Returns 1 if the packet has been replaced by an arp request. */
+uint8_t uip_split_output(void);
+#    define router_output() uip_split_output()
+#  else
+#    define router_output() router_output_segment()
+#  endif
+#endif
+
 #endif	/* ROUTER_SUPPORT && UIP_MULTI_STACK */
 
 #endif	/* UIP_ROUTER_H */
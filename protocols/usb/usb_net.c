@@ -27,6 +27,7 @@
 
 #include "protocols/uip/uip.h"
 #include "protocols/uip/uip_router.h"
+#include "protocols/uip/uip_pool.h"
 #include "usbdrv/usbdrv.h"
 #include "requests.h"
 #include "config.h"
@@ -40,6 +41,15 @@ STACK_DEFINITIONS(usb_stack);
 
 static uint16_t usb_rq_index;
 static uint16_t usb_rq_len;
+static uint16_t usb_tx_len;
+
+#ifdef UIP_POOL_SUPPORT
+/* Buffer the packet from the host is written to, either uip_buf or
+   a pool buffer if uip_buf was locked when the request came in. */
+static uint8_t *usb_rq_buf;
+#else
+#define usb_rq_buf uip_buf
+#endif
 
 uint8_t usb_packet_ready;
 
@@ -49,15 +59,29 @@ usb_net_setup(uint8_t  data[8])
   usbRequest_t *rq = (void *)data;
 
   if (rq->bRequest == USB_REQUEST_NET_SEND) {
+#ifdef UIP_POOL_SUPPORT
+    if (usb_rq_buf && usb_rq_len && usb_rq_index >= usb_rq_len)
+      return 0;			  /* Last packet not passed on yet. */
+
+    /* An unfinished packet keeps its buffer, otherwise take uip_buf
+       or a pool buffer if uip_buf is locked. */
+    if (!usb_rq_buf) {
+      if (!uip_buf_lock())
+	usb_rq_buf = uip_buf;
+      else if ((usb_rq_buf = uip_pool_alloc ()) == NULL)
+	return 0;		  /* No buffer available, ignore packet. */
+    }
+#else
     if (uip_buf_lock())	  /* Unable to aquire lock, ignore packet. */
       return 0;
+#endif
 
     usb_rq_index = 0;
     usb_rq_len = rq->wValue.word;
   }
   else if (usb_packet_ready) {
     usbMsgPtr = uip_buf + USB_BRIDGE_OFFSET;
-    return usb_rq_len;
+    return usb_tx_len;
   }
   else
     return 0;
@@ -77,7 +101,7 @@ uint8_t
 usb_net_write(uint8_t *data, uint8_t len)
 {
   if (usb_rq_index + USB_BRIDGE_OFFSET + len < UIP_CONF_BUFFER_SIZE)
-    memcpy(uip_buf + USB_BRIDGE_OFFSET + usb_rq_index, data, len);
+    memcpy(usb_rq_buf + USB_BRIDGE_OFFSET + usb_rq_index, data, len);
   usb_rq_index += len;
 
   if (usb_rq_index >= usb_rq_len) {
@@ -90,9 +114,7 @@ void
 usb_net_txstart (void)
 {
   usb_packet_ready = 1;
-
-  usb_rq_index = 0;
-  usb_rq_len = uip_len;
+  usb_tx_len = uip_len;
 }
 
 void
@@ -100,6 +122,18 @@ usb_net_periodic(void)
 {
   if (usb_rq_len && (usb_rq_index >= usb_rq_len)) {
     /* A packet arrived, put it into uip */
+#ifdef UIP_POOL_SUPPORT
+    if (usb_rq_buf != uip_buf) {
+      /* uip_buf is busy, let the pool pass it on later. */
+      uip_pool_queue (usb_rq_buf, STACK_USB, usb_rq_len + UIP_LLH_LEN);
+      usb_rq_buf = NULL;
+      usb_rq_len = 0;
+      return;
+    }
+#endif
+#ifdef UIP_POOL_SUPPORT
+    usb_rq_buf = NULL;
+#endif
     uip_len = usb_rq_len + UIP_LLH_LEN;
     usb_rq_len = 0;
     router_input (STACK_USB);
@@ -28,6 +28,7 @@
 #include "core/heartbeat.h"
 #include "protocols/zbus/zbus_raw_net.h"
 #include "protocols/zbus/zbus.h"
+#include "protocols/uip/uip_pool.h"
 
 #ifndef ZBUS_USE_USART
 #define ZBUS_USE_USART 0
@@ -52,6 +53,15 @@ static uint8_t bus_blocked = 0;
 static volatile zbus_index_t zbus_index;
 volatile zbus_index_t zbus_txlen;
 static volatile zbus_index_t zbus_rxlen;
+
+#ifdef UIP_POOL_SUPPORT
+/* Buffer the packet is received to, either uip_buf or a pool buffer
+   if uip_buf was locked at the start condition. */
+static uint8_t *zbus_rxbuf;
+#define zbus_rxdata (zbus_rxbuf + ZBUS_BRIDGE_OFFSET)
+#else
+#define zbus_rxdata zbus_buf
+#endif
 #ifdef ZBUS_ECMD
 uint16_t zbus_rx_frameerror;
 uint16_t zbus_rx_overflow;
@@ -304,8 +314,26 @@ ISR (usart (USART, _RX_vect))
 
       if (data == ZBUS_START)
 	{
+#ifdef UIP_POOL_SUPPORT
+	  /* If the previous packet was never ended, reuse its buffer. */
+	  if (zbus_rxbuf == uip_buf)
+	    ;
+	  else if (!uip_buf_lock ())
+	    {
+	      if (zbus_rxbuf)
+		uip_pool_free (zbus_rxbuf);
+	      zbus_rxbuf = uip_buf;
+	    }
+#ifdef ZBUS_RAW_SUPPORT
+	  else if (zbus_raw_conn->rport)
+	    return;		/* raw capturing needs uip_buf, ignore packet */
+#endif
+	  else if (!zbus_rxbuf && (zbus_rxbuf = uip_pool_alloc ()) == NULL)
+	    return;		/* no buffer available, ignore packet */
+#else
 	  if (uip_buf_lock ())
 	    return;		/* lock of buffer failed, ignore packet */
+#endif
 
 	  zbus_index = 0;
 	  bus_blocked = 3;
@@ -317,8 +345,23 @@ ISR (usart (USART, _RX_vect))
 	  /* Only if there was a start condition before */
 	  if (bus_blocked)
 	    {
-	      zbus_rxstop ();
-	      zbus_rxlen = zbus_index;
+#ifdef UIP_POOL_SUPPORT
+	      if (zbus_rxbuf && zbus_rxbuf != uip_buf)
+		{
+		  /* Hand the packet to the pool and keep on receiving. */
+		  uip_pool_queue (zbus_rxbuf, STACK_ZBUS,
+				  zbus_index + ZBUS_BRIDGE_OFFSET);
+		  zbus_rxbuf = NULL;
+		}
+	      else if (zbus_rxbuf)
+#endif
+		{
+		  zbus_rxstop ();
+		  zbus_rxlen = zbus_index;
+#ifdef UIP_POOL_SUPPORT
+		  zbus_rxbuf = NULL;
+#endif
+		}
 	    }
 #ifdef STATUSLED_ZBUS_RX_SUPPORT
 	  PIN_CLEAR (STATUSLED_ZBUS_RX);
@@ -358,9 +401,13 @@ ISR (usart (USART, _RX_vect))
       /* If bus is not blocked we aren't on an message */
       if (!bus_blocked)
 	return;
+#ifdef UIP_POOL_SUPPORT
+      if (!zbus_rxbuf)
+	return;
+#endif
 
       bus_blocked = 3;
-      zbus_buf[zbus_index] = data;
+      zbus_rxdata[zbus_index] = data;
       zbus_index++;
     }
 }
@@ -43,6 +43,125 @@ struct cron_event_linkedlist* head;
 struct cron_event_linkedlist* tail;
 uint8_t cron_use_utc;
 
+/* jobs sorted by the minute they are due next */
+static struct cron_event_linkedlist* cron_queue;
+static uint32_t cron_last_due;
+
+#define CRON_NEVER UINT32_MAX
+/* search that many days for the next match, enough for Feb 29 */
+#define CRON_SEARCH_DAYS (8 * 366)
+
+static void
+cron_now(struct clock_datetime_t *d, uint32_t timestamp)
+{
+	if (cron_use_utc)
+		clock_datetime(d, timestamp);
+	else
+		clock_localtime(d, timestamp);
+}
+
+/* monotonic key of the minute described by d */
+static uint32_t
+cron_key(struct clock_datetime_t *d)
+{
+	return ((uint32_t) d->year << 20) | ((uint32_t) d->month << 16)
+		| ((uint32_t) d->day << 11) | ((uint16_t) d->hour << 6) | d->min;
+}
+
+/* wildcard (-1), absolute value (>= 0) or step value (< -1) */
+static uint8_t
+cron_field_match(int8_t field, uint8_t value)
+{
+	if (field == -1)
+		return 1;
+	if (field >= 0)
+		return field == value;
+	return (value % -field) == 0;
+}
+
+static void
+cron_next_day(struct clock_datetime_t *t)
+{
+	uint16_t year = t->year + 1900;
+	uint8_t days = 31;
+
+	if (t->month == 2)
+		days = is_leap_year(year) ? 29 : 28;
+	else if (t->month == 4 || t->month == 6 || t->month == 9 || t->month == 11)
+		days = 30;
+
+	t->min = 0;
+	t->hour = 0;
+	t->dow = (t->dow + 1) % 7;
+	if (++t->day > days) {
+		t->day = 1;
+		if (++t->month > 12) {
+			t->month = 1;
+			t->year++;
+		}
+	}
+}
+
+/* find the first minute at or after t the job matches, t is modified */
+static uint32_t
+cron_next_due(struct cron_event *ev, struct clock_datetime_t *t)
+{
+	for (uint16_t days = CRON_SEARCH_DAYS; days; days--)
+	{
+		if (cron_field_match(ev->fields[3], t->month)
+		    && cron_field_match(ev->fields[2], t->day)
+		    && (cron_field_match(ev->fields[4], t->dow)
+			|| (ev->fields[4] & (1 << t->dow))))
+		{
+			for (; t->hour < 24; t->hour++, t->min = 0)
+			{
+				if (!cron_field_match(ev->fields[1], t->hour))
+					continue;
+				for (; t->min < 60; t->min++)
+					if (cron_field_match(ev->fields[0], t->min))
+						return cron_key(t);
+			}
+		}
+		cron_next_day(t);
+	}
+	return CRON_NEVER;
+}
+
+static void
+cron_queue_remove(struct cron_event_linkedlist* job)
+{
+	struct cron_event_linkedlist** p = &cron_queue;
+	while (*p && *p != job)
+		p = &(*p)->queue;
+	if (*p)
+		*p = job->queue;
+}
+
+/* compute when the job is due next, starting at minute d, and queue it
+ * behind all jobs due at the same time */
+static void
+cron_schedule(struct cron_event_linkedlist* job, struct clock_datetime_t *d)
+{
+	struct clock_datetime_t t = *d;
+	job->due = cron_next_due(&job->event, &t);
+
+	struct cron_event_linkedlist** p = &cron_queue;
+	while (*p && (*p)->due <= job->due)
+		p = &(*p)->queue;
+	job->queue = *p;
+	*p = job;
+}
+
+static void
+cron_reschedule(struct cron_event_linkedlist* job)
+{
+	struct clock_datetime_t d;
+
+	cron_queue_remove(job);
+	cron_now(&d, clock_get_time());
+	cron_schedule(job, &d);
+}
+
 #ifdef CRON_VFS_SUPPORT
 void
 cron_load()
@@ -193,6 +312,8 @@ cron_make_persistent(uint8_t jobnumber)
 	}
 
 	job->event.persistent = 1;
+	/* the flag shares its byte with the day of week */
+	cron_reschedule(job);
 	return 1;
 }
 #endif
@@ -204,6 +325,8 @@ cron_init(void)
 	// very important: set the linked lists head and tail to zero
 	head = 0;
 	tail = 0;
+	cron_queue = 0;
+	cron_last_due = 0;
 
 	// do we want to have some test entries?
 	#ifdef CRON_SUPPORT_TEST
@@ -347,6 +470,8 @@ cron_insert(struct cron_event_linkedlist* newone, int8_t position)
 			#endif
 		}
 	}
+
+	cron_reschedule(newone);
 }
 
 void
@@ -365,6 +490,8 @@ cron_jobrm(struct cron_event_linkedlist* job)
 	if (job->next)
 		job->next->prev = job->prev;
 
+	cron_queue_remove(job);
+
 	// free the current element
 	free (job);
 
@@ -416,91 +543,77 @@ cron_periodic(void)
 	if (!head || (timestamp - last_check) < 60) return;
 
 	/* get time and date from unix timestamp */
-	if (cron_use_utc)
-		clock_datetime(&d, timestamp);
-	else
-		clock_localtime(&d, timestamp);
-	
-	/* check every event for a match */
-	struct cron_event_linkedlist* current = head;
+	cron_now(&d, timestamp);
+
+	/* save the actual timestamp */
+	last_check = timestamp - d.sec;
+
+	uint32_t now = cron_key(&d);
 	struct cron_event_linkedlist* exec;
-	uint8_t condition;
-	uint8_t counter = 0;
-	while(current)
+
+	/* The clock has been set back (or daylight saving time ended), so
+	 * the queued due times may lie too far in the future */
+	if (now < cron_last_due)
 	{
-		/* backup current cronjob and advance current */
-		exec = current;
-		current = current->next;
-		++counter;
+		cron_queue = 0;
+		for (exec = head; exec; exec = exec->next)
+			cron_schedule(exec, &d);
+	}
+	cron_last_due = now;
+
+	/* execute the jobs at the head of the queue that are due */
+	while (cron_queue && cron_queue->due <= now)
+	{
+		exec = cron_queue;
+		cron_queue = exec->queue;
 
-		/* check if cron 'exec' matches current time */
-		for (condition = 0; condition < 5; ++condition)
+		/* missed while the clock jumped forward, don't catch up */
+		if (exec->due < now)
 		{
-			/* if this field has a wildcard, just go on checking */
-			if (exec->event.fields[condition] == -1)
-				continue;
-
-			/* If this field has an absolute value, check this value, if it does
-			 * not match, this event does not match */
-			if (exec->event.fields[condition] >= 0 && (exec->event.fields[condition] != d.cron_fields[condition]))
-				break;
-
-			/* If this field has a step value and that is within the steps,
-			 * this event does not match */
-			if (exec->event.fields[condition] < 0 && (d.cron_fields[condition] % -(exec->event.fields[condition])) )
-				break;
+			cron_schedule(exec, &d);
+			continue;
 		}
-		/* check if cron 'exec' matches weekdays */
-		if(condition==4){
-			if(exec->event.fields[condition] & (1 << d.cron_fields[condition]) )
-				condition++;
-		}
-
 
-		#ifdef DEBUG_CRON
-		//debug_printf("..checked %u (%u) with %u\n", counter, exec->event.cmd, condition);
-		#endif
-
-		/* if it matches all conditions , execute the handler function */
-		if (condition==5) {
-			if (exec->event.cmd == CRON_JUMP)
-			{
-				#ifdef DEBUG_CRON
-				debug_printf("cron: match %u (JUMP %p)\n", counter, &(exec->event.handler));
-				#endif
-				#ifndef DEBUG_CRON_DRYRUN
-				exec->event.handler(&(exec->event.extradata));
-				#endif
-			} else if (exec->event.cmd == CRON_ECMD)
-			{
-				// ECMD PARSER
-				#ifdef DEBUG_CRON
-				debug_printf("cron: match %u (%s)\n", counter, (char*)&(exec->event.ecmddata));
-				#endif
-				#ifndef DEBUG_CRON_DRYRUN
-				char output[ECMD_INPUTBUF_LENGTH];
-				uint16_t l = ecmd_parse_command((char*)&(exec->event.ecmddata), output, sizeof(output)-1);
-				#ifdef DEBUG_CRON
-				if (is_ECMD_FINAL(l) || is_ECMD_AGAIN(l)) {
-					output[is_ECMD_AGAIN(l) ? ECMD_AGAIN(l) : l] = 0;
-					debug_printf("cron output %s\n", output);
-				}
-				#endif
-				#endif
+		if (exec->event.cmd == CRON_JUMP)
+		{
+			#ifdef DEBUG_CRON
+			debug_printf("cron: match (JUMP %p)\n", &(exec->event.handler));
+			#endif
+			#ifndef DEBUG_CRON_DRYRUN
+			exec->event.handler(&(exec->event.extradata));
+			#endif
+		} else if (exec->event.cmd == CRON_ECMD)
+		{
+			// ECMD PARSER
+			#ifdef DEBUG_CRON
+			debug_printf("cron: match (%s)\n", (char*)&(exec->event.ecmddata));
+			#endif
+			#ifndef DEBUG_CRON_DRYRUN
+			char output[ECMD_INPUTBUF_LENGTH];
+			uint16_t l = ecmd_parse_command((char*)&(exec->event.ecmddata), output, sizeof(output)-1);
+			#ifdef DEBUG_CRON
+			if (is_ECMD_FINAL(l) || is_ECMD_AGAIN(l)) {
+				output[is_ECMD_AGAIN(l) ? ECMD_AGAIN(l) : l] = 0;
+				debug_printf("cron output %s\n", output);
 			}
+			#endif
+			#endif
+		}
 
-			/* Execute job endless if repeat value is equal to zero otherwise
-			 * decrement the value and check if is equal to zero.
-			 * If that is the case, it is time to kick out this cronjob. */
-			if (exec->event.repeat > 0 && !(--exec->event.repeat))
-				cron_jobrm(exec);
-
-			exec = 0;
+		/* Execute job endless if repeat value is equal to zero otherwise
+		 * decrement the value and check if is equal to zero.
+		 * If that is the case, it is time to kick out this cronjob. */
+		if (exec->event.repeat > 0 && !(--exec->event.repeat))
+		{
+			cron_jobrm(exec);
+			continue;
 		}
-	}
 
-	/* save the actual timestamp */
-	last_check = timestamp - d.sec;
+		/* due again in the next minute at the earliest */
+		struct clock_datetime_t t = d;
+		t.min++;
+		cron_schedule(exec, &t);
+	}
 }
 
 /*
@@ -90,6 +90,9 @@ struct cron_event_linkedlist
 	// last entry's next is NULL, heads prev is NULL
 	struct cron_event_linkedlist* next;
 	struct cron_event_linkedlist* prev;
+	// schedule queue, sorted by the time the job is due next
+	struct cron_event_linkedlist* queue;
+	uint32_t due;
 	struct cron_event event;
 };
 
@@ -162,8 +165,9 @@ struct cron_event_linkedlist* cron_getjob(uint8_t jobposition);
 /** init cron. (Set head to NULL for example) */
 void cron_init(void);
 
-/** periodically check, if an event matches the current time. must be called
-  * once per minute */
+/** periodically check, if an event is due at the current time. Jobs are
+  * kept in a queue sorted by the minute they are due next, so only the
+  * queue's head has to be compared. */
 void cron_periodic(void);
 
 #endif /* _CRON_H */
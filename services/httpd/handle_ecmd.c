@@ -22,6 +22,7 @@
 #include "protocols/ecmd/parser.h"
 #include "protocols/ecmd/ecmd-base.h"
 #include "httpd.h"
+#include "services/pam/pam_prototypes.h"
 
 
 #ifdef DEBUG_HTTPD
@@ -31,6 +32,29 @@
 # define printf(...)   ((void)0)
 #endif
 
+/* Fill the output buffer with the next line of the reply, set eof if
+   it is the last one.  Returns -1 on error. */
+static int8_t
+httpd_handle_ecmd_parse (void)
+{
+    int16_t len = ecmd_parse_command(STATE->u.ecmd.input,
+				     STATE->u.ecmd.output,
+				     ECMD_OUTPUTBUF_LENGTH - 2);
+    if (is_ECMD_AGAIN(len)) {
+	/* convert ECMD_AGAIN back to ECMD_FINAL */
+	len = ECMD_AGAIN(len);
+    }
+    else if (is_ECMD_ERR(len))
+	return -1;
+    else
+	STATE->eof = 1;
+
+    STATE->u.ecmd.output[len++] = 10;
+    STATE->u.ecmd.output[len] = 0;
+    return 0;
+}
+
+
 void
 httpd_handle_ecmd_setup (char *encoded_cmd)
 {
@@ -64,6 +88,7 @@ httpd_handle_ecmd_setup (char *encoded_cmd)
     }
 
     *ptr = 0;
+    STATE->u.ecmd.parsed = 0;
     STATE->handler = httpd_handle_ecmd;
 }
 
@@ -73,7 +98,22 @@ httpd_handle_ecmd_send_header (void)
 {
     PASTE_RESET ();
     PASTE_P (httpd_header_200);
-    PASTE_P (httpd_header_ecmd);
+
+    if (STATE->eof) {
+	/* Complete reply known, send it with the header. */
+	PASTE_CONNECTION ();
+	PASTE_P (httpd_header_length);
+	PASTE_PF (PSTR ("%u\n"), strlen (STATE->u.ecmd.output));
+	PASTE_P (httpd_header_ecmd);
+	strcat (uip_appdata, STATE->u.ecmd.output);
+    }
+    else {
+	/* Length unknown, close the connection afterwards. */
+	STATE->keepalive = 0;
+	PASTE_P (httpd_header_close);
+	PASTE_P (httpd_header_ecmd);
+    }
+
     PASTE_SEND ();
 }
 
@@ -81,35 +121,44 @@ httpd_handle_ecmd_send_header (void)
 void
 httpd_handle_ecmd (void)
 {
-    if (uip_acked ())
-	STATE->header_acked = 1;
-
-    if (!STATE->header_acked) {
-	httpd_handle_ecmd_send_header ();
+#ifdef HTTPD_AUTH_SUPPORT
+    /* Never run a command before the client has been authenticated. */
+    if (STATE->auth_state != PAM_SUCCESS)
 	return;
+#endif
+
+    if (!STATE->u.ecmd.parsed) {
+	/* Parse the first line of output now, so single line replies
+	   can be sent along with the header. */
+	STATE->u.ecmd.parsed = 1;
+	if (httpd_handle_ecmd_parse ()) {
+	    STATE->u.ecmd.output[0] = 0;
+	    STATE->keepalive = 0;
+	    STATE->eof = 1;
+	}
     }
 
-    if (!uip_rexmit ()) {
-	if (STATE->eof)
-	    uip_close ();
-	else {
-	    int16_t len = ecmd_parse_command(STATE->u.ecmd.input,
-					     STATE->u.ecmd.output,
-					     ECMD_OUTPUTBUF_LENGTH - 2);
-	    if (is_ECMD_AGAIN(len)) {
-		/* convert ECMD_AGAIN back to ECMD_FINAL */
-		len = ECMD_AGAIN(len);
-            }
-	    else if (is_ECMD_ERR(len)) {	/* Error */
-		uip_close();
+    if (uip_acked ()) {
+	if (!STATE->header_acked) {
+	    STATE->header_acked = 1;
+	    if (STATE->eof) {
+		httpd_finish ();
 		return;
 	    }
-	    else
-		STATE->eof = 1;
-
-	    STATE->u.ecmd.output[len++] = 10;
-	    STATE->u.ecmd.output[len] = 0;
 	}
+	else if (STATE->eof) {
+	    uip_close ();
+	    return;
+	}
+	else if (httpd_handle_ecmd_parse ()) {	/* Error */
+	    uip_close ();
+	    return;
+	}
+    }
+
+    if (!STATE->header_acked) {
+	httpd_handle_ecmd_send_header ();
+	return;
     }
 
     uip_send (STATE->u.ecmd.output, strlen (STATE->u.ecmd.output));
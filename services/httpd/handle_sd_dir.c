@@ -44,13 +44,18 @@ const char PROGMEM httpd_sd_dir_entry_dir[] =
 
 const char PROGMEM httpd_header_301_redirect[] =
     "HTTP/1.1 301 REDIRECT\n"
+    "Connection: close\n"
     "Location: %s/\n\n";
 
 static void
 httpd_handle_sd_dir_send_header (void)
 {
+    /* The length of the listing is unknown. */
+    STATE->keepalive = 0;
+
     PASTE_RESET ();
     PASTE_P (httpd_header_200);
+    PASTE_P (httpd_header_close);
     PASTE_P (httpd_header_ct_html);
     PASTE_PF (httpd_sd_dir_header, STATE->u.dir.dirname);
 
@@ -71,7 +71,7 @@ httpd_handle_soap (void)
     }
 
     if (uip_acked ()) {
-	uip_close ();
+	httpd_finish ();
 	return;
     }
 
@@ -84,13 +84,26 @@ httpd_handle_soap (void)
     if (STATE->u.soap.parsing_complete) {
 	PASTE_RESET ();
 
-	if (STATE->u.soap.error)
+	if (STATE->u.soap.error) {
+	    STATE->keepalive = 0;
 	    PASTE_P (httpd_header_500_xml);
-	else
+	}
+	else {
 	    PASTE_P (httpd_header_200);
+	    PASTE_CONNECTION ();
+	}
 
+	/* Reserve space for the length, it's filled in after the
+	   result has been pasted. */
+	PASTE_P (httpd_header_length);
+	char *length = uip_appdata + strlen (uip_appdata);
+	PASTE_P (PSTR ("     \n"));
 	PASTE_P (httpd_header_ct_xml);
+
+	char *body = uip_appdata + strlen (uip_appdata);
 	soap_paste_result (&STATE->u.soap);
+	sprintf_P (length, PSTR ("%5u"), strlen (body));
+	length[5] = '\n';
 	PASTE_SEND ();
     }
 }
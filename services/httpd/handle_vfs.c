@@ -27,18 +27,119 @@
 #define READ_AHEAD_LEN 2
 #endif
 
+#ifdef HTTPD_CACHE_SUPPORT
+static void
+httpd_handle_vfs_send_cache (uint32_t etag)
+{
+    uint32_t max_age;
+
+    if (STATE->u.vfs.content_type == 'S')
+	max_age = HTTPD_MAX_AGE_CSS;
+    else if (STATE->u.vfs.content_type == 'I')
+	max_age = HTTPD_MAX_AGE_IMAGE;
+    else
+	max_age = HTTPD_MAX_AGE_HTML;
+
+    PASTE_PF (httpd_header_max_age, (unsigned long) max_age);
+    if (etag)
+	PASTE_PF (httpd_header_etag, (unsigned long) etag);
+}
+#endif	/* HTTPD_CACHE_SUPPORT */
+
+#ifdef HTTPD_RANGE_SUPPORT
+/* Resolve the requested byte range against the file size LEN, returns
+   1 if only part of the file is to be sent. */
+static uint8_t
+httpd_handle_vfs_range (vfs_size_t len)
+{
+    uint8_t range = STATE->u.vfs.range;
+    if (range == HTTPD_RANGE_PARTIAL)
+	return 1;		/* Resolved already, rexmit. */
+
+    vfs_size_t start = STATE->u.vfs.start;
+    vfs_size_t end = STATE->u.vfs.end;
+
+    STATE->u.vfs.range = HTTPD_RANGE_NONE;
+    STATE->u.vfs.start = 0;
+    STATE->u.vfs.end = len;
+
+    if (range == HTTPD_RANGE_NONE || len == 0
+#ifndef VFS_TEENSY
+	|| !VFS_HAVE_FUNC (STATE->u.vfs.fd, fseek)
+#endif
+	)
+	return 0;
+
+    if (range == HTTPD_RANGE_SUFFIX) {
+	start = start < len ? len - start : 0;
+	end = len;
+    }
+    else if (end == 0 || end > len)
+	end = len;
+
+    if (start >= end)
+	return 0;		/* Not satisfiable, send the whole file. */
+
+    STATE->u.vfs.range = HTTPD_RANGE_PARTIAL;
+    STATE->u.vfs.start = start;
+    STATE->u.vfs.end = end;
+    return 1;
+}
+#endif	/* HTTPD_RANGE_SUPPORT */
+
 static void
 httpd_handle_vfs_send_header (void)
 {
     PASTE_RESET ();
-    PASTE_P (httpd_header_200);
+
+#ifdef HTTPD_CACHE_SUPPORT
+    uint32_t etag = vfs_etag (STATE->u.vfs.fd);
+    if (etag && etag == STATE->u.vfs.etag) {
+	/* The client's copy is up to date, no body to send. */
+	STATE->eof = 1;
+	PASTE_P (httpd_header_304);
+	PASTE_CONNECTION ();
+	httpd_handle_vfs_send_cache (etag);
+	PASTE_P (httpd_header_end);
+	PASTE_SEND ();
+	return;
+    }
+#endif	/* HTTPD_CACHE_SUPPORT */
 
     vfs_size_t len = vfs_size (STATE->u.vfs.fd);
+
+#ifdef HTTPD_RANGE_SUPPORT
+    if (httpd_handle_vfs_range (len)) {
+	PASTE_P (httpd_header_206);
+	PASTE_CONNECTION ();
+	PASTE_P (httpd_header_length);
+	PASTE_LEN (STATE->u.vfs.end - STATE->u.vfs.start);
+	PASTE_PF (httpd_header_content_range,
+		  (unsigned long) STATE->u.vfs.start,
+		  (unsigned long) STATE->u.vfs.end - 1, (unsigned long) len);
+    }
+    else
+#endif	/* HTTPD_RANGE_SUPPORT */
     if (len > 0) {
 	/* send content-length header */
+	PASTE_P (httpd_header_200);
+	PASTE_CONNECTION ();
 	PASTE_P (httpd_header_length);
 	PASTE_LEN (len);
+#ifdef HTTPD_RANGE_SUPPORT
+	PASTE_P (httpd_header_accept_ranges);
+#endif
     }
+    else {
+	/* Length unknown, the end of the body is marked by closing. */
+	STATE->keepalive = 0;
+	PASTE_P (httpd_header_200);
+	PASTE_P (httpd_header_close);
+    }
+
+#ifdef HTTPD_CACHE_SUPPORT
+    httpd_handle_vfs_send_cache (etag);
+#endif
 
     /* Check whether the file is gzip compressed. */
     unsigned char buf[READ_AHEAD_LEN];
@@ -84,8 +185,25 @@ no_gzip:
 void
 httpd_handle_vfs_send_body (void)
 {
-    vfs_fseek (STATE->u.vfs.fd, STATE->u.vfs.acked, SEEK_SET);
-    vfs_size_t len = vfs_read (STATE->u.vfs.fd, uip_appdata, uip_mss ());
+    /* The file position is at sent, rewind only if it has not been
+       acked, i.e. on rexmit. */
+    if (STATE->u.vfs.sent != STATE->u.vfs.acked)
+	vfs_fseek (STATE->u.vfs.fd, STATE->u.vfs.acked, SEEK_SET);
+
+    vfs_size_t len = uip_mss ();
+#ifdef HTTPD_RANGE_SUPPORT
+    /* Stop at the end of the requested range. */
+    if (STATE->u.vfs.end && STATE->u.vfs.end - STATE->u.vfs.acked < len)
+	len = STATE->u.vfs.end - STATE->u.vfs.acked;
+#endif
+
+    len = vfs_read (STATE->u.vfs.fd, uip_appdata, len);
+
+    if (len == 0 && STATE->u.vfs.acked) {
+	/* Size is a multiple of the MSS, nothing left. */
+	httpd_finish ();
+	return;
+    }
 
     if (len <= 0) {
 	uip_abort ();
@@ -98,6 +216,7 @@ httpd_handle_vfs_send_body (void)
 
     STATE->u.vfs.sent = STATE->u.vfs.acked + len;
     uip_send (uip_appdata, len);
+    uip_split ();
 }
 
 void
@@ -108,7 +227,13 @@ httpd_handle_vfs (void)
 	    STATE->u.vfs.acked = STATE->u.vfs.sent;
 	else {
 	    STATE->header_acked = 1;
-	    STATE->u.vfs.acked = 0;
+	    STATE->u.vfs.acked = STATE->u.vfs.sent = 0;
+#ifdef HTTPD_RANGE_SUPPORT
+	    if (STATE->u.vfs.range == HTTPD_RANGE_PARTIAL) {
+		STATE->u.vfs.acked = STATE->u.vfs.sent = STATE->u.vfs.start;
+		vfs_fseek (STATE->u.vfs.fd, STATE->u.vfs.start, SEEK_SET);
+	    }
+#endif
 	}
     }
 
@@ -116,7 +241,7 @@ httpd_handle_vfs (void)
 	httpd_handle_vfs_send_header ();
 
     else if (STATE->eof && !uip_rexmit())
-	uip_close ();
+	httpd_finish ();
 
     else
 	httpd_handle_vfs_send_body ();
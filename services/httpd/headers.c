@@ -24,10 +24,19 @@
 
 
 const char PROGMEM httpd_header_200[] =
-"HTTP/1.1 200 OK\n"
+"HTTP/1.1 200 OK\n";
+
+
+const char PROGMEM httpd_header_close[] =
 "Connection: close\n";
 
 
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+const char PROGMEM httpd_header_keepalive[] =
+"Connection: keep-alive\n";
+#endif	/* HTTPD_KEEPALIVE_SUPPORT */
+
+
 const char PROGMEM httpd_header_ct_css[] =
 "Content-Type: text/css; charset=utf-8\n\n";
 
@@ -58,6 +67,34 @@ const char PROGMEM httpd_header_400[] =
 "Content-Type: text/plain; charset=utf-8\n";
 
 
+#ifdef HTTPD_CACHE_SUPPORT
+const char PROGMEM httpd_header_304[] =
+"HTTP/1.1 304 Not Modified\n";
+
+
+const char PROGMEM httpd_header_etag[] =
+"ETag: \"%08lx\"\n";
+
+
+const char PROGMEM httpd_header_max_age[] =
+"Cache-Control: max-age=%lu\n";
+#endif	/* HTTPD_CACHE_SUPPORT */
+
+
+#ifdef HTTPD_RANGE_SUPPORT
+const char PROGMEM httpd_header_206[] =
+"HTTP/1.1 206 Partial Content\n";
+
+
+const char PROGMEM httpd_header_content_range[] =
+"Content-Range: bytes %lu-%lu/%lu\n";
+
+
+const char PROGMEM httpd_header_accept_ranges[] =
+"Accept-Ranges: bytes\n";
+#endif	/* HTTPD_RANGE_SUPPORT */
+
+
 const char PROGMEM httpd_header_gzip[] =
 "Content-Encoding: gzip\n";
 
@@ -81,7 +118,6 @@ const char PROGMEM httpd_body_400[] =
 
 const char PROGMEM httpd_header_404[] =
 "HTTP/1.1 404 File Not Found\n"
-"Connection: close\n"
 "Content-Type: text/plain; charset=utf-8\n";
 
 
@@ -77,6 +77,148 @@ httpd_cleanup (void)
 }
 
 
+static void
+httpd_reset (void)
+{
+    STATE->handler = NULL;
+    STATE->header_acked = 0;
+    STATE->eof = 0;
+    STATE->header_reparse = 0;
+    STATE->keepalive = 0;
+#ifdef HTTPD_AUTH_SUPPORT
+    STATE->auth_state = PAM_UNKOWN;
+#endif
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+    STATE->idle = HTTPD_KEEPALIVE_TIMEOUT * 5;
+#endif
+}
+
+
+/* The response has been sent completely, either close the connection
+   or wait for the next request on it. */
+void
+httpd_finish (void)
+{
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+    if (STATE->keepalive) {
+	printf ("httpd: keeping connection alive\n");
+	httpd_cleanup ();
+	httpd_reset ();
+	return;
+    }
+#endif	/* HTTPD_KEEPALIVE_SUPPORT */
+
+    uip_close ();
+}
+
+
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+/* HTTP/1.1 connections are persistent unless the client asks
+   otherwise, HTTP/1.0 ones only on request.  The request has to be
+   complete in this segment, otherwise we could not tell the rest of
+   it from the next request.  Pipelined requests following in the same
+   segment can't be kept while answering, so the connection is closed
+   after the response and the client sends them again. */
+static void
+httpd_check_keepalive (void)
+{
+    char *data = (char *) uip_appdata;
+    data[uip_len] = 0;
+
+    char *ptr = strstr_P (data, PSTR ("\r\n"));
+    if (ptr == NULL)
+	return;
+
+    char *end = strstr_P (ptr, PSTR ("\r\n\r\n"));
+    if (end == NULL)
+	return;
+
+    /* Anything but a request body after the header is the next
+       request. */
+    if (end + 4 != data + uip_len
+	&& strncasecmp_P (data, PSTR ("POST "), 5) != 0)
+	return;
+
+    STATE->keepalive = ptr - data >= 8
+	&& strncmp_P (ptr - 8, PSTR ("HTTP/1.1"), 8) == 0;
+
+    ptr = strstr_P (ptr, PSTR ("\nConnection: "));
+    if (ptr) {
+	ptr += 13;
+	if (strncasecmp_P (ptr, PSTR ("close"), 5) == 0)
+	    STATE->keepalive = 0;
+	else if (strncasecmp_P (ptr, PSTR ("keep-alive"), 10) == 0)
+	    STATE->keepalive = 1;
+    }
+}
+#endif	/* HTTPD_KEEPALIVE_SUPPORT */
+
+
+#ifdef HTTPD_CACHE_SUPPORT
+/* Remember the entity tag the client has a copy of, the tag is only
+   compared after the file has been opened. */
+static void
+httpd_parse_etag (char *ptr)
+{
+    STATE->u.vfs.etag = 0;
+    ((char *) uip_appdata)[uip_len] = 0;
+
+    ptr = strstr_P (ptr, PSTR ("\nIf-None-Match: "));
+    if (ptr == NULL)
+	return;
+
+    ptr += 16;
+    if (ptr[0] == 'W' && ptr[1] == '/')
+	ptr += 2;		/* Weak tags compare equal as well. */
+    if (*ptr == '"')
+	STATE->u.vfs.etag = strtoul (ptr + 1, NULL, 16);
+}
+#endif	/* HTTPD_CACHE_SUPPORT */
+
+
+#ifdef HTTPD_RANGE_SUPPORT
+/* Parse a single "Range: bytes=" specification.  Multiple ranges and
+   conditional ones (If-Range) are answered with the whole file. */
+static void
+httpd_parse_range (char *ptr)
+{
+    STATE->u.vfs.range = HTTPD_RANGE_NONE;
+    ((char *) uip_appdata)[uip_len] = 0;
+
+    if (strstr_P (ptr, PSTR ("\nIf-Range: ")))
+	return;
+
+    ptr = strstr_P (ptr, PSTR ("\nRange: bytes="));
+    if (ptr == NULL)
+	return;
+
+    ptr += 14;
+    uint8_t range = HTTPD_RANGE_SET;
+    if (*ptr == '-') {
+	range = HTTPD_RANGE_SUFFIX;
+	ptr ++;
+    }
+    else if (*ptr < '0' || *ptr > '9')
+	return;
+
+    STATE->u.vfs.start = strtoul (ptr, &ptr, 10);
+    STATE->u.vfs.end = 0;
+
+    if (range == HTTPD_RANGE_SET) {
+	if (*ptr++ != '-')
+	    return;
+	if (*ptr >= '0' && *ptr <= '9')
+	    STATE->u.vfs.end = strtoul (ptr, &ptr, 10) + 1;
+    }
+
+    if (*ptr == ',')
+	return;
+
+    STATE->u.vfs.range = range;
+}
+#endif	/* HTTPD_RANGE_SUPPORT */
+
+
 static void
 httpd_handle_input (void)
 {
@@ -96,6 +238,10 @@ httpd_handle_input (void)
 	return;
     }
 
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+    httpd_check_keepalive ();
+#endif
+
 #ifdef HTTPD_SOAP_SUPPORT
     if (strncasecmp_P (uip_appdata, PSTR ("POST /soap"), 10) == 0) {
       soap_initialize_context (&STATE->u.soap);
@@ -121,6 +267,13 @@ httpd_handle_input (void)
 
     *ptr = 0;			/* Terminate filename. */
 
+#ifdef HTTPD_CACHE_SUPPORT
+    httpd_parse_etag (ptr + 1);
+#endif
+#ifdef HTTPD_RANGE_SUPPORT
+    httpd_parse_range (ptr + 1);
+#endif
+
     /*
      * Successfully parsed the GET request,
      * possibly check authentication.
@@ -303,19 +456,46 @@ httpd_main(void)
 	printf ("httpd: new connection\n");
 
 	/* initialize struct */
-	STATE->handler = NULL;
-	STATE->header_acked = 0;
-	STATE->eof = 0;
-	STATE->header_reparse = 0;
-#ifdef HTTPD_AUTH_SUPPORT
-        STATE->auth_state = PAM_UNKOWN;
-#endif
+	httpd_reset ();
     }
 
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+    uint8_t next_request = 0;
+#endif
+
     if (uip_newdata() && (!STATE->handler || STATE->header_reparse)) {
 	printf ("httpd: new data\n");
 	httpd_handle_input ();
     }
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+    else if (uip_newdata() && STATE->keepalive
+#ifdef HTTPD_SOAP_SUPPORT
+	     && !(STATE->handler == httpd_handle_soap	/* request body */
+		  && !STATE->u.soap.parsing_complete)
+#endif
+	     ) {
+	/* Clients usually send the next request along with the ACK of
+	   the last response segment.  Let the handler finish the
+	   response first, the request is parsed below. */
+	if (uip_acked())
+	    next_request = 1;
+	else {
+	    /* The next request arrived while still answering this one,
+	       uIP can't hold it back.  Close once the response is done,
+	       the client sends it again on a new connection. */
+	    printf ("httpd: pipelined request, closing after response\n");
+	    STATE->keepalive = 0;
+	}
+    }
+#endif
+
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+    if (uip_poll() && !STATE->handler && STATE->idle-- == 0) {
+	printf ("httpd: keep-alive timeout\n");
+	uip_close ();
+	return;
+    }
+#endif
 
 #ifdef HTTPD_AUTH_SUPPORT
     if (STATE->auth_state == PAM_DENIED && STATE->handler != httpd_handle_401) {
@@ -323,8 +503,13 @@ httpd_main(void)
       STATE->handler = httpd_handle_401;
       STATE->header_reparse = 0;
       printf("httpd: auth failed\n");
-    } else if (STATE->auth_state == PAM_PENDING)
+    } else if (STATE->auth_state == PAM_PENDING) {
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+      if (next_request)
+	STATE->keepalive = 0;
+#endif
       return; /* Waiting for the PAM Layer */
+    }
 #endif
 
 
@@ -338,6 +523,23 @@ httpd_main(void)
 	if (STATE->handler && (!STATE->header_reparse))
 	    STATE->handler ();
     }
+
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+    if (next_request) {
+	if (STATE->handler) {
+	    /* Response not done yet, the request is lost. */
+	    printf ("httpd: pipelined request, closing after response\n");
+	    STATE->keepalive = 0;
+	    return;
+	}
+
+	/* The response is done and the connection kept, handle the
+	   data of this segment as the next request. */
+	printf ("httpd: next request on kept connection\n");
+	uip_flags &= ~UIP_ACKDATA;
+	httpd_main ();
+    }
+#endif
 }
 
 /*
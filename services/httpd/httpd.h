@@ -37,6 +37,7 @@
 void httpd_init (void);
 void httpd_main (void);
 void httpd_cleanup (void);
+void httpd_finish (void);
 
 void httpd_handle_400 (void);
 void httpd_handle_401 (void);
@@ -54,6 +55,10 @@ PGM_P httpd_mimetype_detect (const uint8_t *);
 
 /* headers */
 extern const char httpd_header_200[];
+extern const char httpd_header_close[];
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+extern const char httpd_header_keepalive[];
+#endif
 extern const char httpd_header_ct_css[];
 extern const char httpd_header_ct_html[];
 extern const char httpd_header_ct_xhtml[];
@@ -65,6 +70,16 @@ extern const char httpd_header_ct_xicon[];
 extern const char httpd_header_ecmd[];
 extern const char httpd_header_400[];
 extern const char httpd_header_gzip[];
+#ifdef HTTPD_RANGE_SUPPORT
+extern const char httpd_header_206[];
+extern const char httpd_header_content_range[];
+extern const char httpd_header_accept_ranges[];
+#endif
+#ifdef HTTPD_CACHE_SUPPORT
+extern const char httpd_header_304[];
+extern const char httpd_header_etag[];
+extern const char httpd_header_max_age[];
+#endif
 extern const char httpd_header_401[];
 extern const char httpd_body_401[];
 extern const char httpd_body_400[];
@@ -92,6 +107,14 @@ extern const char httpd_header_end[];
 #define PASTE_LEN_P(a)    sprintf_P(uip_appdata + strlen(uip_appdata),	\
 				    PSTR ("%u\n"), strlen_P(a))
 
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+#  define PASTE_CONNECTION()  PASTE_P (STATE->keepalive		\
+				     ? httpd_header_keepalive	\
+				     : httpd_header_close)
+#else
+#  define PASTE_CONNECTION()  PASTE_P (httpd_header_close)
+#endif
+
 /* FIXME maybe check uip_mss and emit warning on debugging console. */
 #define PASTE_SEND()    uip_send(uip_appdata, strlen(uip_appdata))
 
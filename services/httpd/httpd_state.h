@@ -34,10 +34,23 @@ typedef enum {
 
 #define SD_DIR_MAX_DIRNAME_LEN 75
 
+enum {
+    HTTPD_RANGE_NONE = 0,
+    HTTPD_RANGE_SET,		/* bytes start to end (exclusive, or 0) */
+    HTTPD_RANGE_SUFFIX,		/* the last start bytes */
+    HTTPD_RANGE_PARTIAL,	/* resolved, send start to end */
+};
+
 struct httpd_connection_state_t {
     unsigned header_acked		: 1;
     unsigned header_reparse		: 1;
     unsigned eof			: 1;
+    unsigned keepalive			: 1;
+
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+    /* Polls left before an idle keep-alive connection is closed. */
+    uint8_t idle;
+#endif
 
 #ifdef HTTPD_AUTH_SUPPORT
         uint8_t auth_state;
@@ -56,6 +69,17 @@ struct httpd_connection_state_t {
 	    unsigned char content_type;
 
 	    vfs_size_t acked, sent;
+
+#ifdef HTTPD_RANGE_SUPPORT
+	    /* Requested byte range, see HTTPD_RANGE_*. */
+	    uint8_t range;
+	    vfs_size_t start, end;
+#endif
+
+#ifdef HTTPD_CACHE_SUPPORT
+	    /* Entity tag from If-None-Match, 0 if none. */
+	    uint32_t etag;
+#endif
 	} vfs;
 #endif	/* VFS_SUPPORT */
 
@@ -78,6 +102,9 @@ struct httpd_connection_state_t {
 	struct {
 	    char input[ECMD_INPUTBUF_LENGTH];
 	    char output[ECMD_OUTPUTBUF_LENGTH];
+	    /* Set once the command has been run, i.e. after
+	       authentication. */
+	    uint8_t parsed;
 	} ecmd;
 #endif	/* ECMD_PARSER_SUPPORT */
 
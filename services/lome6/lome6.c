@@ -31,6 +31,10 @@ int16_t lome6_get_temperature (ow_rom_code_t *rom) {
 
 	int16_t retval = 0x7FFF;  // error
 
+	// bus is busy (polling, "1w list")
+	if (ow_global.lock)
+		return retval;
+
 	// disable interrupts
 	uint8_t sreg = SREG;
 	cli();
@@ -205,7 +209,8 @@ void lome6_timer(void) {
 	}
 
 	// start a new convert in next round
-	ow_temp_start_convert_nowait(NULL);
+	if (!ow_global.lock)
+		ow_temp_start_convert_nowait(NULL);
 #endif // LOME6_LCD_SUPPORT
 
 }
@@ -176,11 +176,20 @@ void starburst_update()
 void starburst_main()
 {
 #ifdef STARBURST_PCA9685
+#ifdef I2C_QUEUE_SUPPORT
+	/*The values are sent from the TWI interrupt, wait until the last frame is out*/
+	static struct i2c_transaction pca9685_transaction;
+	static uint16_t pca9685_values[2*STARBURST_PCA9685_CHANNELS];
+	if(pca9685_transaction.status == I2C_PENDING)
+		return;
+#endif
 	if(update == STARBURST_UPDATE) /*Only transmit if at least one channels has been updated*/
 	{
 		update=STARBURST_NOUPDATE;
+#ifndef I2C_QUEUE_SUPPORT
 		/*Prepare Array*/
 		uint16_t pca9685_values[2*STARBURST_PCA9685_CHANNELS];
+#endif
 		for(uint8_t i=0;i<STARBURST_PCA9685_CHANNELS*2;i+=2)
 		{
 			uint16_t tmp=pgm_read_word_near(stevens_power_12bit + pca9685_channels[i/2].value);
@@ -201,7 +210,11 @@ void starburst_main()
 				pca9685_values[i+1]=tmp;
 			}
 		}
+#ifdef I2C_QUEUE_SUPPORT
+		i2c_pca9685_set_leds_async(&pca9685_transaction,STARBURST_PCA9685_ADDRESS,0,STARBURST_PCA9685_CHANNELS*2,pca9685_values);
+#else
 		i2c_pca9685_set_leds(STARBURST_PCA9685_ADDRESS,0,STARBURST_PCA9685_CHANNELS*2,pca9685_values);
+#endif
 	}
 #endif
 }
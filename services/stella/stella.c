@@ -33,6 +33,32 @@
 #define stella_normal 2
 #define stella_fast 3
 
+#ifdef STELLA_GAMMACORRECTION
+#include "stella_gamma.h"
+
+#define stella_gamma_10 10
+#define stella_gamma_12 12
+/* bits of the duty cycle below the 8-bit pwm value */
+#define STELLA_DITHER_BITS (STELLA_GAMMA_RESOLUTION - 8)
+
+/* ordered dithering: in pwm cycle n a channel gets one more tick, if
+ * its fraction is above stella_dither_order[n] */
+#if STELLA_DITHER_BITS == 4
+static const uint8_t stella_dither_order[] PROGMEM =
+	{ 0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15 };
+#else
+static const uint8_t stella_dither_order[] PROGMEM = { 0, 2, 1, 3 };
+#endif
+
+uint8_t stella_gamma = 1;
+/* set if some channel has a fraction, i.e. needs a new table every cycle */
+static uint8_t stella_dither;
+/* dithered pwm values of the current cycle */
+static uint8_t stella_pwm[STELLA_CHANNELS];
+#else
+#define stella_pwm stella_brightness
+#endif
+
 uint8_t stella_brightness[STELLA_CHANNELS];
 uint8_t stella_fade[STELLA_CHANNELS];
 
@@ -49,12 +75,39 @@ struct stella_timetable_struct* cal_table;
 #ifdef DMX_STORAGE_SUPPORT
 uint8_t stella_dmx_conn_id;
 #endif
+
+/* port register and pin mask of each channel, and the index of its port */
+static struct stella_port_with_portmask stella_pin[STELLA_CHANNELS];
+static uint8_t stella_pin_port[STELLA_CHANNELS];
+static volatile uint8_t* stella_ports[STELLA_PORT_COUNT];
+
+/* channel numbers, sorted by brightness from high to low */
+static uint8_t stella_order[STELLA_CHANNELS];
+
 void stella_sort(void);
 
+/* Assign the pins of a port range to the next channels */
+static void
+stella_init_port(const uint8_t port, volatile uint8_t* reg, const uint8_t pins,
+		 const uint8_t offset, uint8_t* channel)
+{
+	stella_portmask[port] = ((1 << pins) - 1) << offset;
+	stella_ports[port] = reg;
+
+	for (uint8_t i = 0; i < pins; ++i, ++*channel)
+	{
+		stella_pin[*channel].port = reg;
+		stella_pin[*channel].mask = _BV(i + offset);
+		stella_pin_port[*channel] = port;
+	}
+}
+
 /* Initialize stella */
 void
 stella_init (void)
 {
+	uint8_t channel = 0;
+
 	int_table = &timetable_1;
 	cal_table = &timetable_2;
 	cal_table->head = 0;
@@ -62,16 +115,19 @@ stella_init (void)
 	stella_sync = NOTHING_NEW;
 
 	/* set stella port pins to output and save the port mask */
-	stella_portmask[0] = ((1 << STELLA_PINS_PORT1) - 1) << STELLA_OFFSET_PORT1;
+	stella_init_port(0, &STELLA_PORT1, STELLA_PINS_PORT1, STELLA_OFFSET_PORT1, &channel);
 	STELLA_DDR_PORT1 |= stella_portmask[0];
-	cal_table->port[0].port = &STELLA_PORT1;
-	cal_table->port[0].mask = 0;
 	#ifdef STELLA_PINS_PORT2
-		stella_portmask[1] = ((1 << STELLA_PINS_PORT2) - 1) << STELLA_OFFSET_PORT2;
+		stella_init_port(1, &STELLA_PORT2, STELLA_PINS_PORT2, STELLA_OFFSET_PORT2, &channel);
 		STELLA_DDR_PORT2 |= stella_portmask[1];
-		cal_table->port[0].port = &STELLA_PORT2;
-		cal_table->port[1].mask = 0;
 	#endif
+	#ifdef STELLA_PINS_PORT3
+		stella_init_port(2, &STELLA_PORT3, STELLA_PINS_PORT3, STELLA_OFFSET_PORT3, &channel);
+		STELLA_DDR_PORT3 |= stella_portmask[2];
+	#endif
+
+	for (channel = 0; channel < STELLA_CHANNELS; ++channel)
+		stella_order[channel] = channel;
 
 	/* initialise the fade counter. Fading works like this:
 	* -> decrement fade_counter
@@ -159,6 +215,13 @@ stella_process (void)
 		stella_fade_counter = stella_fade_step;
 	}
 
+	#ifdef STELLA_GAMMACORRECTION
+	/* Dithering: calculate the table for the next pwm cycle as soon
+	 * as the interrupt has taken the last one. */
+	if (stella_dither && stella_sync == NOTHING_NEW)
+		stella_sync = UPDATE_VALUES;
+	#endif
+
 	/* sort if new values are available */
 	if (stella_sync == UPDATE_VALUES)
 		stella_sort();
@@ -196,6 +259,12 @@ stella_setValue(const enum stella_set_function func, const uint8_t channel, cons
 				debug_printf("STELLA: set flashy value: %d\n", value);
 			#endif
 			break;
+		#ifdef STELLA_GAMMACORRECTION
+		case STELLA_SET_GAMMA:
+			stella_gamma = value;
+			stella_sync = UPDATE_VALUES;
+			break;
+		#endif
 		case STELLA_SET_IMMEDIATELY_RELATIVE:
 			stella_brightness[channel] += (int8_t)value;
 			stella_fade[channel] += (int8_t)value;
@@ -255,6 +324,47 @@ stella_storeToEEROM()
 }
 #endif
 
+#ifdef STELLA_GAMMACORRECTION
+/* Map the brightness levels through the gamma table to duty cycles
+ * of STELLA_GAMMA_RESOLUTION bits and dither them down to the 8-bit
+ * pwm values of the next cycle. */
+static void
+stella_dither_values(void)
+{
+	static uint8_t phase;
+	uint8_t threshold, pwm, i;
+	uint16_t duty;
+
+	threshold = pgm_read_byte(&stella_dither_order[phase]);
+	phase = (phase + 1) & ((1 << STELLA_DITHER_BITS) - 1);
+	stella_dither = 0;
+
+	for (i = 0; i < STELLA_CHANNELS; ++i)
+	{
+		if (!stella_gamma)
+		{
+			stella_pwm[i] = stella_brightness[i];
+			continue;
+		}
+
+		duty = pgm_read_word(&stella_gamma_table[stella_brightness[i]]);
+		#if STELLA_GAMMA_RESOLUTION == 10
+		duty = duty ? (duty >> 2) | (duty < 4) : 0;
+		#endif
+		pwm = duty >> STELLA_DITHER_BITS;
+		duty &= (1 << STELLA_DITHER_BITS) - 1;
+
+		if (duty && pwm < 255)
+		{
+			stella_dither = 1;
+			if (duty > threshold)
+				pwm++;
+		}
+		stella_pwm[i] = pwm;
+	}
+}
+#endif
+
 /* How to use:
  * Do not call this directly, but use "stella_sync = UPDATE_VALUES" instead.
  * Purpose:
@@ -263,134 +373,98 @@ stella_storeToEEROM()
  * channels one after the other depending on their brightness level
  * and point in time.
  * Implementation details:
- * Use a "linked list" to avoid expensive memory copies. Main difference
- * to a real linked list is, that all elements are already preallocated
- * on the stack and are not allocated on demand.
+ * stella_order keeps the channels sorted across calls. Fading changes
+ * brightness values only by small steps, so just the changed channels
+ * move by a few places and the insertion sort below is about linear.
+ * From this order the timetable is built in a single pass as a "linked
+ * list" to avoid expensive memory copies. Main difference to a real
+ * linked list is, that all elements are already preallocated and are
+ * not allocated on demand.
  * The function directly writes to a "just calculated"-structure and if we
  * want new values in the pwm interrupt, we just have to swap pointers from
  * the "interrupt save"-structure to the "just calculated"-structure. (The
  * meaning of both structures changes, too, of course.)
- * Although we provide each channel in the structure with its neccessary
- * information such as portmask and brightness level, we will actually
- * ignore brightness levels of 0% and 100% due to not linking them to the linked list.
+ * With gamma correction the 8-bit values of the current pwm cycle
+ * (stella_pwm) are sorted instead of the brightness levels.
+ * Brightness levels of 0% and 100% are not linked to the list.
  * 100%-level channels are switched on at the beginning of each
  * pwm cycle and not touched afterwards. Channels with same brightness
- * levels are merged together (their portmask at least).
+ * levels on the same port are merged together (their portmask).
  * */
 inline void
 stella_sort()
 {
-	struct stella_timetable_entry* current, *last;
-	uint8_t i;
+	struct stella_timetable_entry* entry, *last = 0;
+	/* list entry of the current brightness level, per port */
+	struct stella_timetable_entry* level[STELLA_PORT_COUNT];
+	uint8_t i, j, ch, port;
 
-	cal_table->head = 0;
-	cal_table->port[0].mask = 0;
-	cal_table->port[0].port = &STELLA_PORT1;
-	#ifdef STELLA_PINS_PORT2
-		cal_table->port[1].mask = 0;
-		cal_table->port[1].port = &STELLA_PORT2;
+	#ifdef STELLA_GAMMACORRECTION
+	stella_dither_values();
 	#endif
 
-	for (i=0;i<STELLA_CHANNELS;++i)
+	for (i = 1; i < STELLA_CHANNELS; ++i)
 	{
-		/* set data of channel i */
-		cal_table->channel[i].port.mask = _BV(i+STELLA_OFFSET_PORT1);
-		cal_table->channel[i].port.port = &STELLA_PORT1;
-		#ifdef STELLA_PINS_PORT2
-		if (i>=STELLA_PINS_PORT1) {
-			cal_table->channel[i].port.mask = _BV( (i-STELLA_PINS_PORT1) +STELLA_OFFSET_PORT2);
-			cal_table->channel[i].port.port = &STELLA_PORT2;
-		}
-		#endif
-		cal_table->channel[i].value = 255 - stella_brightness[i];
-		cal_table->channel[i].next = 0;
+		ch = stella_order[i];
+		for (j = i; j && stella_pwm[stella_order[j-1]] < stella_pwm[ch]; --j)
+			stella_order[j] = stella_order[j-1];
+		stella_order[j] = ch;
+	}
 
-		/* Special case: 0% brightness (Don't include this channel!) */
-		if (stella_brightness[i] == 0) continue;
+	cal_table->head = 0;
+	for (port = 0; port < STELLA_PORT_COUNT; ++port)
+	{
+		cal_table->port[port].port = stella_ports[port];
+		cal_table->port[port].mask = 0;
+		level[port] = 0;
+	}
 
-		//cal_table->portmask |= _BV(i+STELLA_OFFSET);
+	for (i = 0; i < STELLA_CHANNELS; ++i)
+	{
+		ch = stella_order[i];
+		port = stella_pin_port[ch];
 
-		/* Special case: 100% brightness (Merge pwm cycle start masks! Don't include this channel!) */
-		if (stella_brightness[i] == 255)
+		/* Special case: 0% brightness, so are all following channels */
+		if (stella_pwm[ch] == 0) break;
+
+		/* Special case: 100% brightness (Merge pwm cycle start masks!) */
+		if (stella_pwm[ch] == 255)
 		{
-			#ifdef STELLA_PINS_PORT2
-			if (i>=STELLA_PINS_PORT1)
-				cal_table->port[1].mask |= _BV( (i-STELLA_PINS_PORT1) +STELLA_OFFSET_PORT2);
-			else
-				cal_table->port[0].mask |= _BV(i+STELLA_OFFSET_PORT1);
-			#else
-				cal_table->port[0].mask |= _BV(i+STELLA_OFFSET_PORT1);
-			#endif
+			cal_table->port[port].mask |= stella_pin[ch].mask;
 			continue;
 		}
 
-		/* first item in linked list */
-		if (!cal_table->head)
+		entry = &(cal_table->channel[ch]);
+		entry->value = 255 - stella_pwm[ch];
+
+		/* next brightness level */
+		if (last && last->value != entry->value)
+			memset(level, 0, sizeof(level));
+
+		/* same value as a channel on this port: just update the portmask */
+		if (level[port])
 		{
-			cal_table->head = &(cal_table->channel[i]);
+			level[port]->port.mask |= stella_pin[ch].mask;
 			continue;
 		}
-		/* add to linked list with >=1 entries */
-		current = cal_table->head; last = 0;
-		while (current)
-		{
-			// same value as current item: do not add to linked list
-			// but just update the portmask (DO THIS ONLY IF BOTH CHANNELS OPERATE ON THE SAME PORT)
-			if (current->value == cal_table->channel[i].value && current->port.port == cal_table->channel[i].port.port)
-			{
-				#ifdef STELLA_PINS_PORT2
-				if (i>=STELLA_PINS_PORT1)
-					current->port.mask |= _BV( (i-STELLA_PINS_PORT1) +STELLA_OFFSET_PORT2);
-				else
-					current->port.mask |= _BV(i+STELLA_OFFSET_PORT1);
-				#else
-				current->port.mask |= _BV(i+STELLA_OFFSET_PORT1);
-				#endif
-				break;
-			}
-			// insert our new value at the head of the list
-			else if (!last && current->value > cal_table->channel[i].value)
-			{
-				cal_table->channel[i].next = cal_table->head;
-				cal_table->head = &(cal_table->channel[i]);
-				break;
-			}
-			// insert our new value somewhere in betweem
-			else if (current->value > cal_table->channel[i].value)
-			{
-				cal_table->channel[i].next = last->next;
-				last->next = &(cal_table->channel[i]);
-				break;
-			}
-			// reached the end of the linked list: just append our new entry
-			else if (!current->next)
-			{
-				current->next = &(cal_table->channel[i]);
-				break;
-			}
-			// else go to the next item in the linked list
-			else
-			{
-				last = current;
-				current = current->next;
-			}
-		}
+
+		entry->port = stella_pin[ch];
+		entry->next = 0;
+		if (last)
+			last->next = entry;
+		else
+			cal_table->head = entry;
+		last = level[port] = entry;
 	}
 
 	#ifdef DEBUG_STELLA
-	// debug out
-	current = cal_table->head;
-	i = 0;
-	while (current)
-	{
-		i++;
-		//debug_printf("%u %s\n", current->value, debug_binary(current->portmask));
-		current = current->next;
-	}
 	debug_printf("Mask1: %s %u\n", debug_binary(stella_portmask[0]), stella_portmask[0]);
 	#ifdef STELLA_PINS_PORT2
 	debug_printf("Mask2: %s %u\n", debug_binary(stella_portmask[1]), stella_portmask[1]);
 	#endif
+	#ifdef STELLA_PINS_PORT3
+	debug_printf("Mask3: %s %u\n", debug_binary(stella_portmask[2]), stella_portmask[2]);
+	#endif
 	#endif
 
 	/* Allow the interrupt to actually apply the calculated values */
@@ -26,9 +26,12 @@
 
 #ifdef STELLA_SUPPORT
 
-#ifdef STELLA_PINS_PORT2
+#if defined(STELLA_PINS_PORT3)
+	#define STELLA_PORT_COUNT 3
+	#define STELLA_CHANNELS (STELLA_PINS_PORT1+STELLA_PINS_PORT2+STELLA_PINS_PORT3)
+#elif defined(STELLA_PINS_PORT2)
 	#define STELLA_PORT_COUNT 2
-	#define STELLA_CHANNELS STELLA_PINS_PORT1+STELLA_PINS_PORT2
+	#define STELLA_CHANNELS (STELLA_PINS_PORT1+STELLA_PINS_PORT2)
 #else
 	#define STELLA_PORT_COUNT 1
 	#define STELLA_CHANNELS STELLA_PINS_PORT1
@@ -40,6 +43,7 @@ enum stella_set_function
   STELLA_SET_FADE,
   STELLA_SET_FLASHY,
   STELLA_SET_IMMEDIATELY_RELATIVE,
+  STELLA_SET_GAMMA,
   STELLA_GETALL = 255
 };
 
@@ -102,6 +106,10 @@ extern uint8_t stella_portmask[STELLA_PORT_COUNT];
 extern uint8_t stella_fade_step;
 extern uint8_t stella_fade_func;
 
+#ifdef STELLA_GAMMACORRECTION
+extern uint8_t stella_gamma;
+#endif
+
 extern uint8_t stella_brightness[STELLA_CHANNELS];
 extern uint8_t stella_fade[STELLA_CHANNELS];
 /* stella.c */
@@ -60,6 +60,23 @@ int16_t parse_cmd_stella_fadestep (char *cmd, char *output, uint16_t len)
 	}
 }
 
+#ifdef STELLA_GAMMACORRECTION
+int16_t parse_cmd_stella_gamma (char *cmd, char *output, uint16_t len)
+{
+	while(*cmd && *cmd == ' ') cmd++; //skip whitespace
+	if (*cmd)
+	{
+		stella_setValue(STELLA_SET_GAMMA, 0, atoi(cmd));
+		return ECMD_FINAL_OK;
+	}
+	else
+	{
+		itoa(stella_gamma, output, 10);
+		return ECMD_FINAL(strlen(output));
+	}
+}
+#endif  /* STELLA_GAMMACORRECTION */
+
 int16_t parse_cmd_stella_channels (char *cmd, char *output, uint16_t len)
 {
 	itoa(STELLA_CHANNELS, output, 10);
@@ -153,4 +170,7 @@ ecmd_endif()
 ecmd_feature(stella_channels, "channels",, Return stella channel size)
 ecmd_feature(stella_channel, "channel", CHANNEL VALUE FUNCTION,Get/Set stella channel to value. Second and third parameters are optional. Function: You may use 's' for instant set, 'f' for fade and 'y' for flashy fade. )
 ecmd_feature(stella_fadestep, "fadestep", FADESTEP, Get/Set stella fade step)
+ecmd_ifdef(STELLA_GAMMACORRECTION)
+  ecmd_feature(stella_gamma, "stella gamma", [VALUE], Get/Set gamma corrected high resolution output)
+ecmd_endif()
 */